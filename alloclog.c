@@ -0,0 +1,316 @@
+/*
+ * alloclog.c - Heap allocation logs, see alloclog.h
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "alloclog.h"
+#include "random.h"
+
+/* A live allocation, a node of the treap */
+struct alloc_node {
+	mem_addr_t lo, hi;
+	int site;
+	uint64_t prio;
+	alloc_node_t* left;
+	alloc_node_t* right;
+};
+
+
+/*
+ * grow - make room for one more element of an array grown by doubling
+ */
+static int grow(void** array, size_t count, size_t* cap, size_t size)
+{
+	if(count < *cap)
+		return 0;
+
+	void* more = realloc(*array, (*cap = *cap ? 2 * *cap : 1024) * size);
+	if(!more) {
+		errno = ENOMEM;
+		return -1;
+	}
+	*array = more;
+	return 0;
+}
+
+
+static int byId(const void* x, const void* y)
+{
+	const alloc_site_t* a = x;
+	const alloc_site_t* b = y;
+
+	return a->id < b->id ? -1 : a->id > b->id;
+}
+
+
+/*
+ * resolveSites - sort the sites and turn the site ids of the events
+ * (passed in ids) into indexes; sites used but never described are all
+ * gathered in one last site
+ */
+static int resolveSites(alloc_log_t* log, const uint64_t* ids)
+{
+	int kept = 0, unknown = -1;
+
+	qsort(log->sites, log->site_count, sizeof(alloc_site_t), byId);
+	for(int i = 0; i < log->site_count; i++) {
+		if(kept && log->sites[i].id == log->sites[kept-1].id) {
+			free(log->sites[i].where);
+			continue;
+		}
+		log->sites[kept++] = log->sites[i];
+	}
+	log->site_count = kept;
+
+	for(size_t i = 0; i < log->event_count; i++) {
+		alloc_event_t* ev = &log->events[i];
+		alloc_site_t key = { .id = ids[i] };
+
+		if(ev->op == 'f')
+			continue;
+
+		alloc_site_t* site = bsearch(&key, log->sites, kept, sizeof(alloc_site_t),
+		                             byId);
+		if(site) {
+			ev->site = site - log->sites;
+		} else {
+			if(unknown < 0) {
+				alloc_site_t* more = realloc(log->sites, (kept + 1) *
+				                             sizeof(alloc_site_t));
+				if(!more)
+					return -1;
+				log->sites = more;
+				memset(&more[kept], 0, sizeof(alloc_site_t));
+				more[kept].where = strdup("?");
+				unknown = log->site_count++;
+			}
+			ev->site = unknown;
+		}
+		log->sites[ev->site].count++;
+		log->sites[ev->site].bytes += ev->size;
+	}
+	return 0;
+}
+
+
+int loadAllocLog(alloc_log_t* log, const char* path)
+{
+	FILE* fp = fopen(path, "r");
+	char* line = NULL;
+	size_t line_cap = 0;
+	size_t site_cap = 0, event_cap = 0, id_cap = 0;
+	uint64_t* ids = NULL;
+	int version;
+
+	memset(log, 0, sizeof(*log));
+	if(!fp)
+		return -1;
+
+	if(getline(&line, &line_cap, fp) < 0 ||
+	   strncmp(line, ALLOC_LOG_MAGIC " ", strlen(ALLOC_LOG_MAGIC) + 1) != 0 ||
+	   sscanf(line + strlen(ALLOC_LOG_MAGIC), "%d %llx", &version, &log->marker) != 2 ||
+	   version != ALLOC_LOG_VERSION) {
+		errno = EINVAL;
+		goto fail;
+	}
+
+	while(getline(&line, &line_cap, fp) >= 0) {
+		alloc_event_t ev = { .op = line[0], .site = -1 };
+		unsigned long long id = 0;
+		int where;
+
+		if(line[0] == 's') {
+			if(sscanf(line, "s %llx %n", &id, &where) < 1)
+				continue;
+			if(grow((void**)&log->sites, log->site_count, &site_cap,
+			        sizeof(alloc_site_t)) != 0)
+				goto fail;
+			line[strcspn(line, "\n")] = '\0';
+
+			alloc_site_t* site = &log->sites[log->site_count++];
+			memset(site, 0, sizeof(*site));
+			site->id = id;
+			site->where = strdup(line + where);
+			if(!site->where)
+				goto fail;
+			continue;
+		}
+
+		if(!(line[0] == 'm' &&
+		     sscanf(line, "m %llx %llx %llx", &ev.addr, &ev.size, &id) == 3) &&
+		   !(line[0] == 'r' &&
+		     sscanf(line, "r %llx %llx %llx %llx", &ev.old, &ev.addr, &ev.size,
+		            &id) == 4) &&
+		   !(line[0] == 'f' && sscanf(line, "f %llx", &ev.addr) == 1))
+			continue;
+
+		if(grow((void**)&log->events, log->event_count, &event_cap,
+		        sizeof(alloc_event_t)) != 0 ||
+		   grow((void**)&ids, log->event_count, &id_cap, sizeof(uint64_t)) != 0)
+			goto fail;
+		ids[log->event_count] = id;
+		log->events[log->event_count++] = ev;
+	}
+
+	if(resolveSites(log, ids) != 0)
+		goto fail;
+
+	//at most one node per event
+	log->nodes = malloc((log->event_count + 1) * sizeof(alloc_node_t));
+	if(!log->nodes)
+		goto fail;
+	for(size_t i = 0; i < log->event_count; i++)
+		log->nodes[i].left = &log->nodes[i + 1];
+	log->nodes[log->event_count].left = NULL;
+	log->unused = log->nodes;
+	log->seed = 0x9e3779b97f4a7c15ULL;
+
+	free(ids);
+	free(line);
+	fclose(fp);
+	return 0;
+
+fail:
+	{
+		int err = errno;
+		free(ids);
+		free(line);
+		fclose(fp);
+		freeAllocLog(log);
+		errno = err;
+	}
+	return -1;
+}
+
+
+void freeAllocLog(alloc_log_t* log)
+{
+	for(int i = 0; i < log->site_count; i++)
+		free(log->sites[i].where);
+	free(log->sites);
+	free(log->events);
+	free(log->nodes);
+	memset(log, 0, sizeof(*log));
+}
+
+
+/*
+ * merge - join two treaps, every key of a below every key of b
+ */
+static alloc_node_t* merge(alloc_node_t* a, alloc_node_t* b)
+{
+	if(!a)
+		return b;
+	if(!b)
+		return a;
+	if(a->prio > b->prio) {
+		a->right = merge(a->right, b);
+		return a;
+	}
+	b->left = merge(a, b->left);
+	return b;
+}
+
+/*
+ * split - the nodes of t starting below key into *below, the rest into
+ * *above
+ */
+static void split(alloc_node_t* t, mem_addr_t key, alloc_node_t** below,
+                  alloc_node_t** above)
+{
+	if(!t) {
+		*below = *above = NULL;
+	} else if(t->lo < key) {
+		split(t->right, key, &t->right, above);
+		*below = t;
+	} else {
+		split(t->left, key, below, &t->left);
+		*above = t;
+	}
+}
+
+
+/*
+ * release - drop the allocation starting at addr, if there is one
+ */
+static void release(alloc_log_t* log, mem_addr_t addr)
+{
+	alloc_node_t *below, *rest, *node, *above;
+
+	split(log->root, addr, &below, &rest);
+	split(rest, addr + 1, &node, &above);
+	if(node) {
+		node->left = log->unused;
+		log->unused = node;
+	}
+	log->root = merge(below, above);
+}
+
+
+static void allocate(alloc_log_t* log, mem_addr_t addr, mem_addr_t size, int site)
+{
+	alloc_node_t *below, *above, *node;
+
+	//a block allocated again without a free we saw replaces the old one
+	release(log, addr);
+	node = log->unused;
+	log->unused = node->left;
+
+	node->lo = addr;
+	node->hi = addr + (size ? size : 1);
+	node->site = site;
+	//random priorities keep the treap balanced
+	node->prio = nextRandom(&log->seed);
+	node->left = node->right = NULL;
+
+	split(log->root, addr, &below, &above);
+	log->root = merge(merge(below, node), above);
+}
+
+
+void tickAllocations(alloc_log_t* log)
+{
+	if(log->next == log->event_count)
+		return;
+
+	alloc_event_t* ev = &log->events[log->next++];
+
+	log->last = NULL;
+	switch(ev->op) {
+	case 'r':
+		release(log, ev->old);
+		allocate(log, ev->addr, ev->size, ev->site);
+		break;
+	case 'm':
+		allocate(log, ev->addr, ev->size, ev->site);
+		break;
+	default:
+		release(log, ev->addr);
+	}
+}
+
+
+int findAllocation(alloc_log_t* log, mem_addr_t addr)
+{
+	alloc_node_t* t = log->last;
+
+	//consecutive accesses mostly stay within one block
+	if(t && addr - t->lo < t->hi - t->lo)
+		return t->site;
+
+	for(t = log->root; t; ) {
+		if(addr < t->lo)
+			t = t->left;
+		else if(addr >= t->hi)
+			t = t->right;
+		else {
+			log->last = t;
+			return t->site;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,77 @@
+/*
+ * alloclog.h - Heap allocation logs, and the allocations live at each
+ *     point of a trace
+ *
+ * A log is written by the recorder preloaded into a traced program
+ * (csim-malloc.c), one line per event:
+ *
+ *   csim-malloc 1 <marker>           first line; marker address, hex
+ *   s <site> <frame>[;<frame>...]    a call site, frames as object+0xoffset
+ *   m <addr> <size> <site>           malloc, calloc, aligned allocations
+ *   r <old> <addr> <size> <site>     realloc
+ *   f <addr>                         free
+ *
+ * Numbers are hex.  Every m, r and f line also appears in the trace as a
+ * load of the marker, so replaying the trace and calling tickAllocations()
+ * at each marker load keeps the set of live allocations in step with it.
+ *
+ * Live allocations never overlap, so they are kept in a binary search tree
+ * (a treap) keyed by address: an address falls in the node it is not
+ * below or above.  An allocation is found in O(log n), or at once if it is
+ * the one found last.
+ */
+#ifndef ALLOCLOG_H
+#define ALLOCLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cachesim.h"
+
+#define ALLOC_LOG_MAGIC "csim-malloc"
+#define ALLOC_LOG_VERSION 1
+
+typedef struct alloc_site {
+	uint64_t id;
+	char* where;       // frames, as logged
+	uint64_t count;    // allocations made here
+	uint64_t bytes;
+} alloc_site_t;
+
+typedef struct alloc_event {
+	char op;            // 'm', 'r' or 'f'
+	int site;           // index into the sites, -1 for frees
+	mem_addr_t addr;
+	mem_addr_t old;     // realloc'ed block
+	mem_addr_t size;
+} alloc_event_t;
+
+typedef struct alloc_node alloc_node_t;
+
+typedef struct alloc_log {
+	mem_addr_t marker;
+	int site_count;
+	alloc_site_t* sites;
+	size_t event_count;
+	alloc_event_t* events;
+	size_t next;             // events applied so far
+	alloc_node_t* root;      // live allocations
+	alloc_node_t* last;      // the one found last
+	alloc_node_t* nodes;     // storage for every node
+	alloc_node_t* unused;
+	uint64_t seed;
+} alloc_log_t;
+
+/* Read a log written by csim-malloc; -1 with errno set on failure, EINVAL
+ * if it isn't one */
+int loadAllocLog(alloc_log_t* log, const char* path);
+
+void freeAllocLog(alloc_log_t* log);
+
+/* Apply the next event, as its marker load was just replayed */
+void tickAllocations(alloc_log_t* log);
+
+/* The site of the live allocation holding addr, or -1 */
+int findAllocation(alloc_log_t* log, mem_addr_t addr);
+
+#endif /* ALLOCLOG_H */
@@ -0,0 +1,306 @@
+/*
+ * autotune.c - Search the tiling of tiledTrans() (see tune.h) for the one
+ *     with the fewest misses on a given cache, for each matrix size.
+ *
+ * Every candidate (tile width, tile height, diagonal handling) is run
+ * in-process on the simulated cache (see transsim.h).  The search prunes
+ * in two ways:
+ *  1. tilings whose A and B tiles together need more than twice the lines
+ *  the cache has are never run, they can only thrash;
+ *  2. a run is abandoned as soon as it has missed more often than the best
+ *  tiling found so far (branch and bound).  Candidates are tried with
+ *  power of two tiles first, which usually finds a tight bound early.
+ * Candidates are spread over a pool of threads sharing the bound.
+ *
+ * Usage: autotune [-h] [-z <MxN,...>] [-s <num>] [-E <num>] [-b <num>] [-j <threads>]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "cachelab.h"
+#include "transsim.h"
+#include "tune.h"
+
+/* The cache the handout grades against: 1KB, direct mapped, 32B blocks */
+#define DEFAULT_S 5
+#define DEFAULT_E 1
+#define DEFAULT_B 5
+
+/* Largest matrix side accepted */
+#define MAX_SIDE 4096
+/* Most matrix sizes in one search */
+#define MAX_SIZES 64
+
+static const char* diag_names[DIAG_MODES] = { "none", "defer", "row" };
+
+/* One tiling to try and what became of it */
+typedef struct candidate {
+    tile_params_t params;
+    int misses;     // -1 if the run was cut short
+    int hits;
+    int evictions;
+} candidate_t;
+
+/* The search for one matrix size */
+typedef struct search {
+    int M, N;
+    int s, E, b;
+    candidate_t* cands;
+    int count;
+    int next;       // next candidate to claim
+    int best;       // fewest misses so far, the bound for every run
+    int cut;        // runs abandoned over the bound
+} search_t;
+
+
+/*
+ * tileLines - cache lines touched by one A tile and its B tile, allowing
+ * for rows that don't start on a line boundary
+ */
+int tileLines(int bw, int bh, int B)
+{
+    int ints = B / (int)sizeof(int);
+
+    return bh * ((bw + ints - 1) / ints + 1) + bw * ((bh + ints - 1) / ints + 1);
+}
+
+int isPowerOfTwo(int x)
+{
+    return (x & (x - 1)) == 0;
+}
+
+/* Power of two tiles first, then in plain order */
+int byPromise(const void* x, const void* y)
+{
+    const tile_params_t* a = &((const candidate_t*)x)->params;
+    const tile_params_t* b = &((const candidate_t*)y)->params;
+    int pa = isPowerOfTwo(a->bw) && isPowerOfTwo(a->bh);
+    int pb = isPowerOfTwo(b->bw) && isPowerOfTwo(b->bh);
+
+    if(pa != pb)
+        return pb - pa;
+    if(a->bw != b->bw)
+        return a->bw - b->bw;
+    if(a->bh != b->bh)
+        return a->bh - b->bh;
+    return a->diag - b->diag;
+}
+
+
+/*
+ * searcher - thread pool body, runs candidates until none are left
+ * Each thread has its own matrices and cache; only the bound is shared.
+ */
+void* searcher(void* arg)
+{
+    search_t* z = arg;
+    cache_t cache;
+    jmp_buf abort;
+    int* B;
+    int* A = allocMatrices(z->M, z->N, &B);
+    size_t len = (char*)(B + (size_t)z->M * z->N) - (char*)A;
+    int i;
+
+    initMatrix(z->M, z->N, (void*)A, (void*)B);
+
+    while((i = __atomic_fetch_add(&z->next, 1, __ATOMIC_RELAXED)) < z->count) {
+        candidate_t* c = &z->cands[i];
+
+        initCache(&cache, z->s, z->E, z->b);
+        simulateRegion(&cache, A, len);
+
+        //a run equal to the bound may still win on the tie-break
+        if(setjmp(abort) == 0) {
+            simulateBudget(__atomic_load_n(&z->best, __ATOMIC_RELAXED), &abort);
+            tiledTrans(z->M, z->N, (void*)A, (void*)B, &c->params);
+            c->misses = cache.miss_count;
+            c->hits = cache.hit_count;
+            c->evictions = cache.eviction_count;
+
+            int best = __atomic_load_n(&z->best, __ATOMIC_RELAXED);
+            while(c->misses < best &&
+                  !__atomic_compare_exchange_n(&z->best, &best, c->misses, 0,
+                                               __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                ;
+        } else {
+            c->misses = -1;
+            __atomic_fetch_add(&z->cut, 1, __ATOMIC_RELAXED);
+        }
+
+        simulateRegion(NULL, NULL, 0);
+        freeCache(&cache);
+    }
+
+    free(A);
+    return NULL;
+}
+
+
+/*
+ * checkTiling - does the winning tiling really transpose?
+ */
+int checkTiling(int M, int N, tile_params_t* params)
+{
+    int* B;
+    int* A = allocMatrices(M, N, &B);
+    int* ref = malloc((size_t)M * N * sizeof(int));
+
+    initMatrix(M, N, (void*)A, (void*)B);
+    tiledTrans(M, N, (void*)A, (void*)B, params);
+    correctTrans(M, N, (void*)A, (void*)ref);
+    int ok = memcmp(B, ref, (size_t)M * N * sizeof(int)) == 0;
+
+    free(ref);
+    free(A);
+    return ok;
+}
+
+
+/*
+ * tune - search all tilings of one matrix size and print the best
+ */
+void tune(int M, int N, int s, int E, int b, int threads)
+{
+    int maxw = M < MAX_TILE ? M : MAX_TILE;
+    int maxh = N < MAX_TILE ? N : MAX_TILE;
+    int lines = E << s;
+    int pruned = 0;
+    search_t z;
+
+    memset(&z, 0, sizeof(z));
+    z.M = M;
+    z.N = N;
+    z.s = s;
+    z.E = E;
+    z.b = b;
+    z.best = 2 * M * N + 1; // every access missing, and then some
+    z.cands = malloc((size_t)maxw * maxh * DIAG_MODES * sizeof(candidate_t));
+
+    for(int bw = 1; bw <= maxw; bw++) {
+        for(int bh = 1; bh <= maxh; bh++) {
+            if(tileLines(bw, bh, 1 << b) > 2 * lines) {
+                pruned += DIAG_MODES;
+                continue;
+            }
+            for(int diag = 0; diag < DIAG_MODES; diag++) {
+                candidate_t* c = &z.cands[z.count++];
+                c->params.bw = bw;
+                c->params.bh = bh;
+                c->params.diag = diag;
+            }
+        }
+    }
+    qsort(z.cands, z.count, sizeof(candidate_t), byPromise);
+
+    pthread_t* tids = malloc(threads * sizeof(pthread_t));
+    for(int t = 0; t < threads; t++) {
+        if(pthread_create(&tids[t], NULL, searcher, &z) != 0) {
+            fprintf(stderr, "autotune: can't start worker threads\n");
+            exit(1);
+        }
+    }
+    for(int t = 0; t < threads; t++)
+        pthread_join(tids[t], NULL);
+    free(tids);
+
+    //fewest misses, ties going to the earliest (most regular) candidate
+    candidate_t* win = NULL;
+    for(int i = 0; i < z.count; i++) {
+        candidate_t* c = &z.cands[i];
+        if(c->misses >= 0 && (!win || c->misses < win->misses))
+            win = c;
+    }
+
+    if(!win) {
+        printf("%dx%d: every tiling was pruned\n", M, N);
+    } else {
+        printf("%dx%d: bw=%d bh=%d diag=%s misses=%d hits=%d evictions=%d "
+               "correct=%d (%d run, %d cut short, %d pruned)\n", M, N,
+               win->params.bw, win->params.bh, diag_names[win->params.diag],
+               win->misses, win->hits, win->evictions,
+               checkTiling(M, N, &win->params), z.count - z.cut, z.cut, pruned);
+    }
+
+    free(z.cands);
+}
+
+
+/*
+ * printUsage - Print usage info
+ */
+void printUsage(char* argv[])
+{
+    printf("Usage: %s [-h] [-z <MxN,...>] [-s <num>] [-E <num>] [-b <num>] [-j <threads>]\n",
+           argv[0]);
+    printf("Options:\n");
+    printf("  -h         Print this help message.\n");
+    printf("  -z <list>  Matrix sizes to tune for (default 32x32,64x64,61x67).\n");
+    printf("  -s <num>   Number of set index bits (default %d).\n", DEFAULT_S);
+    printf("  -E <num>   Number of lines per set (default %d).\n", DEFAULT_E);
+    printf("  -b <num>   Number of block offset bits (default %d).\n", DEFAULT_B);
+    printf("  -j <num>   Number of threads (default: one per CPU).\n");
+    printf("\nExample:\n");
+    printf("  linux>  %s -z 64x64 -s 6 -E 2 -b 6\n", argv[0]);
+}
+
+int main(int argc, char* argv[])
+{
+    int s = DEFAULT_S, E = DEFAULT_E, b = DEFAULT_B;
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    char default_sizes[] = "32x32,64x64,61x67";
+    char* size_list = default_sizes;
+    int M[MAX_SIZES], N[MAX_SIZES];
+    int count = 0;
+    int c;
+
+    while((c = getopt(argc, argv, "z:s:E:b:j:h")) != -1) {
+        switch(c) {
+        case 'z':
+            size_list = optarg;
+            break;
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 'h':
+            printUsage(argv);
+            exit(0);
+        default:
+            printUsage(argv);
+            exit(1);
+        }
+    }
+
+    for(char* tok = strtok(size_list, ","); tok; tok = strtok(NULL, ",")) {
+        if(count == MAX_SIZES || sscanf(tok, "%dx%d", &M[count], &N[count]) != 2 ||
+           M[count] < 1 || N[count] < 1 || M[count] > MAX_SIDE || N[count] > MAX_SIDE) {
+            printf("%s: bad matrix size %s\n", argv[0], tok);
+            exit(1);
+        }
+        count++;
+    }
+    if(s < 0 || b < 2 || E < 1 || s > 24 || b > 12) {
+        printf("%s: invalid cache geometry\n", argv[0]);
+        exit(1);
+    }
+    if(threads < 1)
+        threads = 1;
+
+    printf("Tuning tiledTrans() for s=%d E=%d b=%d\n", s, E, b);
+    for(int i = 0; i < count; i++)
+        tune(M[i], N[i], s, E, b, threads);
+    return 0;
+}
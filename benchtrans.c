@@ -0,0 +1,324 @@
+/*
+ * benchtrans.c - Time the transpose functions registered in trans.c on the
+ *     host and compare the times with their simulated misses, to check that
+ *     the simulator's counts predict real speed.
+ *
+ * trans.c is linked in twice (see the Makefile): once optimized as is, for
+ * timing, and once instrumented, for the simulator (see transsim.h).  The
+ * simulated cache has the geometry of the host's cache at the chosen
+ * level, as read from sysfs.
+ *
+ * Timing runs on one pinned CPU: every function is run a few times to warm
+ * up, then the median of many timed runs (clock_gettime and rdtsc) is
+ * reported.  The Pearson correlation between median time and misses over
+ * all (function, size) pairs sums up the comparison.
+ *
+ * Usage: benchtrans [-h] [-z <MxN,...>] [-l <level>] [-c <cpu>] [-n <runs>] [-w <runs>]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <getopt.h>
+#include <x86intrin.h>
+
+#include "cachelab.h"
+#include "transsim.h"
+
+/* Largest matrix side accepted */
+#define MAX_SIDE 4096
+/* Most matrix sizes in one run */
+#define MAX_SIZES 64
+/* Most timed runs of one function */
+#define MAX_RUNS 1000
+
+/* The instrumented trans.c registers with registerFunctions(), the native
+ * one was compiled with this name instead */
+void registerNativeFunctions(void);
+
+/* Where the host's cache description lives */
+#define SYSFS_CACHE "/sys/devices/system/cpu/cpu%d/cache/index%d/%s"
+#define SYSFS_INDICES 16
+
+typedef struct matrix_size { int M, N; } matrix_size_t;
+
+/* One (function, size) measurement */
+typedef struct sample {
+    int func;
+    int size;
+    double ns;              // median wall time of one run
+    unsigned long long tsc; // median timestamp counter ticks of one run
+    trans_func_t sim;       // simulated counts
+} sample_t;
+
+
+/*
+ * readSysfs - one number from the host's description of a cache
+ * Returns -1 if the file doesn't exist.
+ */
+long readSysfs(int cpu, int index, const char* name)
+{
+    char path[256];
+    char buf[64];
+    FILE* fp;
+    long value = -1;
+
+    snprintf(path, sizeof(path), SYSFS_CACHE, cpu, index, name);
+    if(!(fp = fopen(path, "r")))
+        return -1;
+    if(fgets(buf, sizeof(buf), fp))
+        value = strtol(buf, NULL, 10);
+    fclose(fp);
+    return value;
+}
+
+int log2i(long x)
+{
+    int n = 0;
+
+    while((1L << n) < x)
+        n++;
+    return (1L << n) == x ? n : -1;
+}
+
+/*
+ * hostGeometry - s, E and b of the cpu's data (or unified) cache at level
+ * Returns -1 if sysfs has no such cache or its geometry isn't a power of
+ * two in sets and line size.
+ */
+int hostGeometry(int cpu, int level, int* s, int* E, int* b)
+{
+    for(int i = 0; i < SYSFS_INDICES; i++) {
+        char path[256];
+        char type[32] = "";
+        FILE* fp;
+
+        if(readSysfs(cpu, i, "level") != level)
+            continue;
+        snprintf(path, sizeof(path), SYSFS_CACHE, cpu, i, "type");
+        if((fp = fopen(path, "r"))) {
+            if(!fgets(type, sizeof(type), fp))
+                type[0] = '\0';
+            fclose(fp);
+        }
+        if(strncmp(type, "Instruction", 11) == 0)
+            continue;
+
+        *s = log2i(readSysfs(cpu, i, "number_of_sets"));
+        *E = readSysfs(cpu, i, "ways_of_associativity");
+        *b = log2i(readSysfs(cpu, i, "coherency_line_size"));
+        return *s < 0 || *E < 1 || *b < 0 ? -1 : 0;
+    }
+    return -1;
+}
+
+
+int byValue(const void* x, const void* y)
+{
+    double a = *(const double*)x;
+    double b = *(const double*)y;
+
+    return a < b ? -1 : a > b;
+}
+
+double median(double* v, int n)
+{
+    qsort(v, n, sizeof(double), byValue);
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/*
+ * timeFunction - median time of runs calls of func on M x N matrices,
+ * after warmup untimed calls
+ */
+void timeFunction(trans_func_t* func, int M, int N, int warmup, int runs,
+                  sample_t* out)
+{
+    static double ns[MAX_RUNS], ticks[MAX_RUNS];
+    int* B;
+    int* A = allocMatrices(M, N, &B);
+
+    initMatrix(M, N, (void*)A, (void*)B);
+    for(int r = 0; r < warmup; r++)
+        func->func_ptr(M, N, (void*)A, (void*)B);
+
+    for(int r = 0; r < runs; r++) {
+        double t0 = now();
+        unsigned long long c0 = __rdtsc();
+        func->func_ptr(M, N, (void*)A, (void*)B);
+        ticks[r] = __rdtsc() - c0;
+        ns[r] = now() - t0;
+    }
+
+    out->ns = median(ns, runs);
+    out->tsc = median(ticks, runs);
+    free(A);
+}
+
+
+/*
+ * correlation - Pearson's r between x and y, NAN if either is constant
+ */
+double correlation(const double* x, const double* y, int n)
+{
+    double mx = 0, my = 0, sxy = 0, sxx = 0, syy = 0;
+
+    for(int i = 0; i < n; i++) {
+        mx += x[i] / n;
+        my += y[i] / n;
+    }
+    for(int i = 0; i < n; i++) {
+        sxy += (x[i] - mx) * (y[i] - my);
+        sxx += (x[i] - mx) * (x[i] - mx);
+        syy += (y[i] - my) * (y[i] - my);
+    }
+    return sxx > 0 && syy > 0 ? sxy / sqrt(sxx * syy) : NAN;
+}
+
+
+/*
+ * printUsage - Print usage info
+ */
+void printUsage(char* argv[])
+{
+    printf("Usage: %s [-h] [-z <MxN,...>] [-l <level>] [-c <cpu>] [-n <runs>] [-w <runs>]\n",
+           argv[0]);
+    printf("Options:\n");
+    printf("  -h         Print this help message.\n");
+    printf("  -z <list>  Matrix sizes (default 256x256,1024x1024,1031x1031).\n");
+    printf("  -l <num>   Host cache level to simulate (default 1).\n");
+    printf("  -c <num>   CPU to pin the timing runs to (default 0).\n");
+    printf("  -n <num>   Timed runs per function and size (default 21).\n");
+    printf("  -w <num>   Warm-up runs before timing (default 3).\n");
+    printf("\nExample:\n");
+    printf("  linux>  %s -z 2048x2048 -l 2\n", argv[0]);
+}
+
+int main(int argc, char* argv[])
+{
+    char default_sizes[] = "256x256,1024x1024,1031x1031";
+    char* size_list = default_sizes;
+    matrix_size_t sizes[MAX_SIZES];
+    int size_count = 0;
+    int level = 1, cpu = 0, runs = 21, warmup = 3;
+    int s, E, b;
+    int c;
+
+    while((c = getopt(argc, argv, "z:l:c:n:w:h")) != -1) {
+        switch(c) {
+        case 'z':
+            size_list = optarg;
+            break;
+        case 'l':
+            level = atoi(optarg);
+            break;
+        case 'c':
+            cpu = atoi(optarg);
+            break;
+        case 'n':
+            runs = atoi(optarg);
+            break;
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+        case 'h':
+            printUsage(argv);
+            exit(0);
+        default:
+            printUsage(argv);
+            exit(1);
+        }
+    }
+
+    for(char* tok = strtok(size_list, ","); tok; tok = strtok(NULL, ",")) {
+        matrix_size_t* z = &sizes[size_count];
+        if(size_count == MAX_SIZES || sscanf(tok, "%dx%d", &z->M, &z->N) != 2 ||
+           z->M < 1 || z->N < 1 || z->M > MAX_SIDE || z->N > MAX_SIDE) {
+            printf("%s: bad matrix size %s\n", argv[0], tok);
+            exit(1);
+        }
+        size_count++;
+    }
+    if(runs < 1 || runs > MAX_RUNS || warmup < 0) {
+        printf("%s: invalid number of runs\n", argv[0]);
+        exit(1);
+    }
+
+    if(hostGeometry(cpu, level, &s, &E, &b) != 0) {
+        printf("%s: no usable level %d cache for cpu %d in sysfs\n", argv[0],
+               level, cpu);
+        exit(1);
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if(sched_setaffinity(0, sizeof(set), &set) != 0) {
+        perror("sched_setaffinity");
+        exit(1);
+    }
+
+    //the instrumented functions first, their native twins after them
+    registerFunctions();
+    int funcs = func_counter;
+    registerNativeFunctions();
+    if(func_counter != 2 * funcs) {
+        printf("%s: native and simulated builds of trans.c disagree\n", argv[0]);
+        exit(1);
+    }
+
+    printf("Host L%d cache on cpu %d: s=%d E=%d b=%d (%d KB)\n", level, cpu,
+           s, E, b, (E << (s + b)) / 1024);
+    printf("Median of %d runs after %d warm-up runs\n", runs, warmup);
+
+    int count = funcs * size_count;
+    sample_t* samples = calloc(count, sizeof(sample_t));
+    double* x = malloc(count * sizeof(double));
+    double* y = malloc(count * sizeof(double));
+
+    for(int z = 0; z < size_count; z++) {
+        int M = sizes[z].M, N = sizes[z].N;
+
+        printf("\n%dx%d\n", M, N);
+        printf("%4s %12s %14s %12s %7s  %s\n", "func", "time (us)", "cycles (tsc)",
+               "misses", "correct", "description");
+
+        for(int f = 0; f < funcs; f++) {
+            sample_t* p = &samples[z * funcs + f];
+
+            p->func = f;
+            p->size = z;
+            p->sim = func_list[f];
+            evalTransFunction(&p->sim, M, N, s, E, b);
+            timeFunction(&func_list[funcs + f], M, N, warmup, runs, p);
+
+            printf("%4d %12.1f %14llu %12u %7d  %s\n", f, p->ns / 1000, p->tsc,
+                   p->sim.num_misses, p->sim.correct, p->sim.description);
+            x[z * funcs + f] = p->ns;
+            y[z * funcs + f] = p->sim.num_misses;
+        }
+    }
+
+    double r = correlation(x, y, count);
+    if(isnan(r))
+        printf("\nCorrelation of time and misses: undefined\n");
+    else
+        printf("\nCorrelation of time and misses over %d samples: r=%.3f\n", count, r);
+
+    free(samples);
+    free(x);
+    free(y);
+    return 0;
+}
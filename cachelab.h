@@ -24,9 +24,16 @@ void printSummary(int hits,  /* number of  hits */
 				  int misses, /* number of misses */
 				  int evictions); /* number of evictions */
 
+/* The registered transpose functions */
+extern trans_func_t func_list[MAX_TRANS_FUNCS];
+extern int func_counter;
+
 /* Fill the matrix with data */
 void initMatrix(int M, int N, int A[N][M], int B[M][N]);
 
+/* Fill a single matrix with random data */
+void randMatrix(int M, int N, int A[N][M]);
+
 /* The baseline trans function that produces correct results. */
 void correctTrans(int M, int N, int A[N][M], int B[M][N]);
 
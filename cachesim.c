@@ -0,0 +1,1061 @@
+/*
+ * cachesim.c - The cache simulator core: an LRU cache of 2^s sets of E
+ *     lines of 2^b bytes, plus a thread-safe shared variant of it.
+ *
+ * See cachesim.h for the interface.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cachesim.h"
+
+/* Upper bound on the number of set locks of a shared cache */
+#define MAX_STRIPES 4096
+
+/* Accesses per lockstep batch, and lanes a thread runs in lockstep */
+#define LOCKSTEP_BATCH 4096
+#define LANE_GROUP 8
+
+/* Largest re-reference prediction value of an rrip line ("distant") */
+#define RRPV_MAX 3
+
+/* Address bits whose parity picks each slice, on Intel Sandy Bridge to
+ * Haswell parts with 2, 4 or 8 slices (Maurice et al., RAID 2015) */
+static const uint64_t slice_masks[3] = {
+	0x1b5f575440ULL,   // bits 6 10 12 14 16-18 20 22 24-28 30 32 33 35 36
+	0x2eb5faa880ULL,   // bits 7 11 13 15 17 19-24 26 28 29 31 33-35 37
+	0x3cccc93100ULL    // bits 8 12 13 16 19 22 23 26 27 30 31 34-37
+};
+
+
+/*
+ * parseCacheIndex - read a set index function (see cachesim.h) for a
+ * cache of 2^s sets
+ */
+int parseCacheIndex(cache_index_t* index, const char* spec, int s)
+{
+	char end;
+
+	memset(index, 0, sizeof(*index));
+
+	if(strcmp(spec, "bits") == 0) {
+		index->kind = INDEX_BITS;
+	} else if(strcmp(spec, "xor") == 0 && s > 0) {
+		index->kind = INDEX_XOR;
+	} else if(strcmp(spec, "prime") == 0 && s <= 30) {
+		//the largest prime up to 2^s
+		int n = 1 << s;
+		for(int d = 2; n > 2 && d * d <= n; d++) {
+			if(n % d == 0) {
+				n--;
+				d = 1;
+			}
+		}
+		index->kind = INDEX_MOD;
+		index->sets = n;
+	} else if(sscanf(spec, "prime:%d%c", &index->sets, &end) == 1 &&
+	          index->sets >= 1) {
+		index->kind = INDEX_MOD;
+	} else if(strncmp(spec, "matrix:", 7) == 0) {
+		const char* p = spec + 7;
+		char* next;
+
+		index->kind = INDEX_MATRIX;
+		while(*p && index->rows < 64) {
+			index->masks[index->rows++] = strtoull(p, &next, 16);
+			if(next == p || (*next != ',' && *next != '\0'))
+				return -1;
+			p = *next ? next + 1 : next;
+		}
+		if(index->rows != s || *p)
+			return -1;
+	} else if(strcmp(spec, "slice") == 0 ||
+	          (sscanf(spec, "slice:%d%c", &index->rows, &end) == 1 &&
+	           index->rows >= 1 && index->rows <= 3)) {
+		index->kind = INDEX_SLICE;
+		if(index->rows == 0)
+			index->rows = 3;
+		if(index->rows > s)
+			return -1;
+		memcpy(index->masks, slice_masks, sizeof(slice_masks));
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
+
+/*
+ * parseCacheOrg - read an organisation (see cachesim.h) for a cache of
+ * 2^s rows of E ways
+ */
+int parseCacheOrg(cache_org_t* org, const char* spec, int s, int E)
+{
+	size_t len = strcspn(spec, ",");
+	const char* victim = spec[len] ? spec + len + 1 : "lru";
+	char end = '\0';
+	int n;
+
+	memset(org, 0, sizeof(*org));
+	org->levels = 1;
+
+	if(len == 3 && strncmp(spec, "set", 3) == 0)
+		return spec[len] ? -1 : 0;
+
+	if(len == 4 && strncmp(spec, "skew", 4) == 0) {
+		org->kind = ORG_SKEW;
+	} else if(len == 6 && strncmp(spec, "zcache", 6) == 0) {
+		org->kind = ORG_ZCACHE;
+		org->levels = 2;
+	} else if((n = sscanf(spec, "zcache:%d%c", &org->levels, &end)) >= 1 &&
+	          (n == 1 || end == ',') && org->levels >= 1 && org->levels <= 8) {
+		org->kind = ORG_ZCACHE;
+	} else {
+		return -1;
+	}
+
+	if(strcmp(victim, "lru") == 0)
+		org->victim = VICTIM_LRU;
+	else if(strcmp(victim, "rrip") == 0)
+		org->victim = VICTIM_RRIP;
+	else
+		return -1;
+
+	//every way needs a hash of at least one bit
+	if(s < 1 || s > 30 || E < 1 || E > SKEW_MAX_WAYS)
+		return -1;
+	return 0;
+}
+
+
+/*
+ * Allocate data structures to hold info regrading the sets and cache lines
+ *
+ * Initialize valid and tag field with 0s, and clear the counters.
+ *
+ */
+void initCache(cache_t* cache, int s, int E, int b)
+{
+	initIndexedCache(cache, s, E, b, NULL);
+}
+
+void initIndexedCache(cache_t* cache, int s, int E, int b,
+                      const cache_index_t* index)
+{
+	cache->s = s;
+	cache->E = E;
+	cache->b = b;
+
+	//calculate S and B using the geometry
+	cache->S = 1 << s;
+	cache->B = 1 << b;
+
+	memset(&cache->index, 0, sizeof(cache->index));
+	memset(&cache->org, 0, sizeof(cache->org));
+	cache->org.levels = 1;
+	cache->way_keys = NULL;
+	cache->clock = 0;
+	cache->sub_bits = 0;
+	cache->sub_valid = cache->sub_dirty = NULL;
+	if(index) {
+		cache->index = *index;
+		if(index->kind == INDEX_MOD)
+			cache->S = index->sets;
+
+		//the offset within a block must not move it to another set
+		for(int i = 0; i < index->rows; i++)
+			cache->index.masks[i] &= ~(mem_addr_t)(cache->B - 1);
+	}
+
+	clearStats(cache);
+
+	//allocate space for the number of sets, and all lines in one block
+	cache->sets = malloc(cache->S * sizeof(cache_set_t));
+	cache->lines = malloc((size_t)cache->S * E * sizeof(cache_line_t));
+
+	if(!cache->sets || !cache->lines) {
+		fprintf(stderr, "initCache: out of memory\n");
+		exit(1);
+	}
+
+	//iterate through sets, hand out their lines
+	for(int i = 0; i < cache->S; i++) {
+
+		cache->sets[i] = cache->lines + (size_t)i * E;
+
+		//set the appropriate field values
+		for(int j = 0; j < E; j++) {
+
+			cache->sets[i][j].valid = '0';
+			cache->sets[i][j].tag = 0;
+			cache->sets[i][j].counter = 0;
+		}
+	}
+}
+
+
+/*
+ * initSkewedCache - a cache whose lines are stored way after way, each
+ * way indexed by its own multiplicative hash
+ */
+void initSkewedCache(cache_t* cache, int s, int E, int b,
+                     const cache_org_t* org)
+{
+	initIndexedCache(cache, s, E, b, NULL);
+	if(!org || org->kind == ORG_SET)
+		return;
+
+	//no set groups the lines, so there is nothing to point at them
+	free(cache->sets);
+	cache->sets = NULL;
+	cache->org = *org;
+
+	cache->way_keys = malloc(E * sizeof(mem_addr_t));
+	if(!cache->way_keys) {
+		fprintf(stderr, "initCache: out of memory\n");
+		exit(1);
+	}
+
+	//odd keys drawn by splitmix64, the same for every run
+	mem_addr_t seed = 0;
+	for(int w = 0; w < E; w++) {
+		mem_addr_t z = (seed += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ z >> 30) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ z >> 27) * 0x94d049bb133111ebULL;
+		cache->way_keys[w] = (z ^ z >> 31) | 1;
+	}
+
+	//rrip lines start out distant, so empty ones are picked first anyway
+	for(size_t i = 0; i < (size_t)cache->S * E; i++)
+		cache->lines[i].counter = org->victim == VICTIM_RRIP ? RRPV_MAX : 0;
+}
+
+
+/*
+ * initSectorCache - a cache with sub-block valid and dirty bits, kept
+ * beside the lines so that other caches don't carry them
+ */
+void initSectorCache(cache_t* cache, int s, int E, int b, int sub_bits,
+                     const cache_index_t* index)
+{
+	size_t nlines;
+
+	initIndexedCache(cache, s, E, b, index);
+	nlines = (size_t)cache->S * E;
+
+	cache->sub_bits = sub_bits;
+	cache->sub_valid = calloc(nlines, sizeof(uint64_t));
+	cache->sub_dirty = calloc(nlines, sizeof(uint64_t));
+	if(!cache->sub_valid || !cache->sub_dirty) {
+		fprintf(stderr, "initCache: out of memory\n");
+		exit(1);
+	}
+}
+
+
+/*
+ * freeCache - free each piece of memory  allocated using malloc
+ * inside initCache() function
+ */
+void freeCache(cache_t* cache)
+{
+
+	//the lines were allocated as one block
+	free(cache->lines);
+
+	//free the set array itself
+	free(cache->sets);
+
+	free(cache->way_keys);
+	free(cache->sub_valid);
+	free(cache->sub_dirty);
+	cache->sub_valid = cache->sub_dirty = NULL;
+
+}
+
+
+/*
+ * accessSet - Look for tag among the E lines of one set.
+ *   On a hit, make the line the most recently used one.
+ *   On a miss, bring it into an empty line, or evict the least recently
+ *   used line if there is none.
+ *   Returns CACHE_HIT, CACHE_MISS or CACHE_MISS | CACHE_EVICT.
+ */
+int accessSet(cache_set_t set, int E, mem_addr_t tag)
+{
+	//values set to arbitrary numbers for finding desired lines
+	int min = INT_MAX;
+	int max = 0;
+	int minIndex = -1;
+
+	//iterate  through all sets and find min and max counters
+	for(int j = 0; j < E; j++) {
+
+		//if it's the new min
+		if(set[j].counter < min) {
+
+			min = set[j].counter;
+			minIndex = j;
+
+		}
+
+		//if it's the new max
+		if(set[j].counter > max) {
+
+			max = set[j].counter;
+		}
+	}
+
+	//iterate through and find the line if possible
+	for(int i = 0; i < E; i++) {
+
+		//if it's valid and the correct tag
+		if(set[i].valid == '1' && set[i].tag == tag) {
+
+			//it's found, set counter val
+			set[i].counter =  max + 1;
+			return CACHE_HIT;
+		}
+	}
+
+	//then it's a miss, iterate through to find any that are empty
+	for(int k = 0; k < E; k++) {
+
+		//if an empty one is found
+		if(set[k].valid == '0') {
+
+			//set that to the target
+			set[k].valid = '1';
+			set[k].tag = tag;
+			set[k].counter = max + 1;
+			return CACHE_MISS;
+		}
+	}
+
+	//no empty ones, evict the minimum counter value line
+	set[minIndex].tag = tag;
+	set[minIndex].counter = max + 1;
+	return CACHE_MISS | CACHE_EVICT;
+}
+
+
+/*
+ * wayLine - the line of way w that block maps to in a skewed cache or
+ * zcache: the top s bits of block times the way's key
+ */
+static inline size_t wayLine(const cache_t* cache, int w, mem_addr_t block)
+{
+	return (size_t)w * cache->S +
+	       (size_t)((block * cache->way_keys[w]) >> (64 - cache->s));
+}
+
+
+/* One candidate of a zcache walk: a line, and the candidate whose block
+ * would move into it (-1 for the lines of the incoming block itself) */
+typedef struct walk_step {
+	size_t line;
+	int parent;
+} walk_step_t;
+
+/*
+ * accessSkewed - accessSet() for a skewed cache or zcache
+ *   A block can only be in its own line of each way.  On a miss, a zcache
+ *   first gathers the lines the blocks in those could move to, level after
+ *   level, then picks the victim among all of them and moves each block on
+ *   the way back to the incoming block's line one step along.
+ */
+static int accessSkewed(cache_t* cache, mem_addr_t block)
+{
+	walk_step_t walk[ZCACHE_MAX_WALK];
+	cache_line_t* lines = cache->lines;
+	int rrip = cache->org.victim == VICTIM_RRIP;
+	int64_t tick = ++cache->clock;
+	int count = 0, empty = -1;
+
+	for(int w = 0; w < cache->E; w++) {
+		size_t i = wayLine(cache, w, block);
+
+		if(lines[i].valid == '1' && lines[i].tag == block) {
+			lines[i].counter = rrip ? 0 : tick;
+			return CACHE_HIT;
+		}
+		if(lines[i].valid != '1' && empty < 0)
+			empty = count;
+		walk[count++] = (walk_step_t){ i, -1 };
+	}
+
+	//expand the walk only while there is no empty line to take
+	for(int level = 1, first = 0; empty < 0 && level < cache->org.levels;
+	    level++) {
+		int last = count;
+
+		for(int c = first; c < last && empty < 0; c++) {
+			mem_addr_t moved = lines[walk[c].line].tag;
+			int way = walk[c].line / cache->S;
+
+			for(int w = 0; w < cache->E && count < ZCACHE_MAX_WALK; w++) {
+				size_t i = wayLine(cache, w, moved);
+				int seen = w == way;
+
+				//a line twice on one path would be overwritten mid-move
+				for(int k = 0; k < count && !seen; k++)
+					seen = walk[k].line == i;
+				if(seen)
+					continue;
+				if(lines[i].valid != '1' && empty < 0)
+					empty = count;
+				walk[count++] = (walk_step_t){ i, c };
+			}
+		}
+		first = last;
+	}
+
+	//the least recently used candidate, or the most distant one
+	int victim = empty;
+	if(victim < 0) {
+		int64_t best = rrip ? -1 : INT64_MAX;
+
+		for(int c = 0; c < count; c++) {
+			int64_t counter = lines[walk[c].line].counter;
+
+			if(rrip ? counter > best : counter < best) {
+				best = counter;
+				victim = c;
+			}
+		}
+
+		//age the candidates until the victim is predicted distant
+		if(rrip && best < RRPV_MAX)
+			for(int c = 0; c < count; c++)
+				lines[walk[c].line].counter += RRPV_MAX - best;
+	}
+
+	int result = lines[walk[victim].line].valid == '1'
+	             ? CACHE_MISS | CACHE_EVICT : CACHE_MISS;
+	int c = victim;
+
+	for(; walk[c].parent >= 0; c = walk[c].parent)
+		lines[walk[c].line] = lines[walk[walk[c].parent].line];
+
+	lines[walk[c].line].valid = '1';
+	lines[walk[c].line].tag = block;
+	lines[walk[c].line].counter = rrip ? RRPV_MAX - 1 : tick;
+	return result;
+}
+
+
+/*
+ * setIndex - the set of addr, by the cache's index function
+ */
+static inline mem_addr_t setIndex(const cache_t* cache, mem_addr_t addr)
+{
+	const cache_index_t* index = &cache->index;
+	mem_addr_t block = addr >> cache->b;
+	mem_addr_t set = 0;
+
+	switch(index->kind) {
+	case INDEX_XOR:
+		//every s bits of the block address folded together
+		for(int shift = 0; shift < 64; shift += cache->s)
+			set ^= block >> shift;
+		return set & (cache->S - 1);
+	case INDEX_MOD:
+		return block % cache->S;
+	case INDEX_MATRIX:
+		for(int i = 0; i < index->rows; i++)
+			set |= (mem_addr_t)__builtin_parityll(addr & index->masks[i]) << i;
+		return set;
+	case INDEX_SLICE:
+		//the slice on top of the low block address bits
+		for(int i = 0; i < index->rows; i++)
+			set |= (mem_addr_t)__builtin_parityll(addr & index->masks[i]) << i;
+		return set << (cache->s - index->rows) |
+		       (block & ((cache->S >> index->rows) - 1));
+	default:
+		return block & (cache->S - 1);
+	}
+}
+
+
+/*
+ * accessData - Access data at memory address addr.
+ *   If it is already in cache, increase hit_count
+ *   If it is not in cache, bring it in cache, increase miss count.
+ *   Increase eviction_count if a line is evicted.
+ */
+void accessData(cache_t* cache, mem_addr_t addr)
+{
+	//the tag is the whole block address, whatever the index function
+	mem_addr_t targTag = addr >> cache->b;
+	int result;
+
+	if(cache->org.kind != ORG_SET) {
+		result = accessSkewed(cache, targTag);
+	} else {
+		//isolate set number
+		mem_addr_t targSet = setIndex(cache, addr);
+
+		result = accessSet(cache->sets[targSet], cache->E, targTag);
+	}
+
+	if(result == CACHE_HIT) {
+		cache->hit_count++;
+	} else {
+		cache->miss_count++;
+		if(result & CACHE_EVICT)
+			cache->eviction_count++;
+	}
+}
+
+
+/*
+ * accessSector - accessData() for a sector cache
+ *   The sector's tag goes through accessSet() like any line's, then the
+ *   line it ended up in has its sub-block bits checked and updated.
+ */
+void accessSector(cache_t* cache, mem_addr_t addr, unsigned int len, int store)
+{
+	mem_addr_t targSet = setIndex(cache, addr);
+	mem_addr_t targTag = addr >> cache->b;
+	int sub_size = cache->B >> cache->sub_bits;
+	int sub_mask = (1 << cache->sub_bits) - 1;
+	int first = (addr >> (cache->b - cache->sub_bits)) & sub_mask;
+	int last = ((addr + (len ? len - 1 : 0)) >> (cache->b - cache->sub_bits)) &
+	           sub_mask;
+	//the sub-blocks first..last (2 << 63 wraps around to all of them)
+	uint64_t bits = ((2ULL << last) - 1) & ~((1ULL << first) - 1);
+	cache_set_t set = cache->sets[targSet];
+
+	int result = accessSet(set, cache->E, targTag);
+
+	//the line now holding the sector
+	int j = 0;
+	while(set[j].valid != '1' || set[j].tag != targTag)
+		j++;
+	size_t line = set + j - cache->lines;
+
+	if(result != CACHE_HIT) {
+		cache->miss_count++;
+		if(result & CACHE_EVICT) {
+			cache->eviction_count++;
+			cache->writeback_bytes +=
+				(long long)__builtin_popcountll(cache->sub_dirty[line]) * sub_size;
+		}
+		cache->sub_valid[line] = cache->sub_dirty[line] = 0;
+	} else if((cache->sub_valid[line] & bits) != bits) {
+		cache->miss_count++;
+		cache->sub_miss_count++;
+	} else {
+		cache->hit_count++;
+	}
+
+	cache->fill_bytes += (long long)__builtin_popcountll(bits &
+		~cache->sub_valid[line]) * sub_size;
+	cache->sub_valid[line] |= bits;
+	if(store)
+		cache->sub_dirty[line] |= bits;
+}
+
+
+/*
+ * accessBlock - simulate a trace record, or the part of it in one block
+ * Translates one "L" as a load i.e. 1 memory access
+ * Translates one "S" as a store i.e. 1 memory access
+ * Translates one "M" as a load followed by a store i.e. 2 memory accesses
+ */
+static inline void accessBlock(cache_t* cache, char op, mem_addr_t addr,
+                               unsigned int len)
+{
+    //a sector cache has to know which accesses store
+    if(cache->sub_valid) {
+        if(op == 'L' || op == 'M')
+            accessSector(cache, addr, len, 0);
+        if(op == 'S' || op == 'M')
+            accessSector(cache, addr, len, 1);
+        return;
+    }
+
+    //if it's a load or a store, access once
+    if(op == 'L' || op == 'S') {
+
+        accessData(cache, addr);
+    }
+
+    //otherwise, do data move and access
+    else if(op == 'M') {
+
+        accessData(cache, addr);
+        accessData(cache, addr);
+    }
+}
+
+
+/*
+ * simulateAccess - simulate a single trace record against the cache, as
+ * an access of one byte
+ */
+void simulateAccess(cache_t* cache, char op, mem_addr_t addr)
+{
+	accessBlock(cache, op, addr, 1);
+}
+
+
+/*
+ * tornAccess - simulate a record the map tears apart, once for each run of
+ * its bytes that stays contiguous and within one block once mapped
+ */
+static void tornAccess(cache_t* cache, char op, mem_addr_t addr,
+                       mem_addr_t last, addr_map_t map, void* map_arg)
+{
+	int parts = 0;
+
+	for(;;) {
+		mem_addr_t to = map(map_arg, addr);
+		mem_addr_t end = addr;
+
+		while(end < last && map(map_arg, end + 1) == to + (end + 1 - addr) &&
+		      ((to ^ (to + (end + 1 - addr))) >> cache->b) == 0)
+			end++;
+		accessBlock(cache, op, to, end - addr + 1);
+		parts++;
+		if(end == last)
+			break;
+		addr = end + 1;
+	}
+	if(parts > 1)
+		cache->straddle_count++;
+}
+
+/*
+ * spanAccess - simulate a record of len bytes, once in each block it
+ * touches where the map (if any) puts it
+ *   A record the map moves as a whole is split in mapped space.  Whether
+ *   its first and last bytes share a block is then a single mask test,
+ *   almost always true, so the split is a well predicted branch away.
+ */
+static inline void spanAccess(cache_t* cache, char op, mem_addr_t addr,
+                              unsigned int len, addr_map_t map, void* map_arg)
+{
+	mem_addr_t last = addr + (len ? len - 1 : 0);
+
+	if(map) {
+		mem_addr_t to = map(map_arg, addr);
+
+		if(__builtin_expect(map(map_arg, last) - to != last - addr, 0)) {
+			tornAccess(cache, op, addr, last, map, map_arg);
+			return;
+		}
+		last = to + (last - addr);
+		addr = to;
+	}
+
+	if(__builtin_expect(((addr ^ last) >> cache->b) == 0, 1)) {
+		accessBlock(cache, op, addr, last - addr + 1);
+		return;
+	}
+
+	cache->straddle_count++;
+	for(;;) {
+		mem_addr_t end = addr | (cache->B - 1);  // last byte of addr's block
+
+		if(end >= last)
+			end = last;
+		accessBlock(cache, op, addr, end - addr + 1);
+		if(end == last)
+			break;
+		addr = end + 1;
+	}
+}
+
+void simulateSpan(cache_t* cache, char op, mem_addr_t addr, unsigned int len)
+{
+	spanAccess(cache, op, addr, len, NULL, NULL);
+}
+
+
+/*
+ * simulateLockstep - run the batch through every lane in turn, mapping
+ * the addresses of the lanes that have a map
+ */
+void simulateLockstep(cache_lane_t* lanes, int count, const access_t* batch,
+                      int n)
+{
+	for(int l = 0; l < count; l++) {
+		cache_lane_t* lane = &lanes[l];
+
+		for(int i = 0; i < n; i++)
+			spanAccess(&lane->cache, batch[i].op, batch[i].addr, batch[i].len,
+			           lane->map, lane->map_arg);
+	}
+}
+
+
+/* A trace and the lanes simulating it, shared by simulateLanes() threads */
+typedef struct lane_pool {
+	cache_lane_t* lanes;
+	int count;
+	int next; // next group of lanes to claim
+	const access_t* trace;
+	size_t length;
+} lane_pool_t;
+
+/*
+ * laneWorker - claim a group of lanes at a time and run the whole trace
+ * through them in lockstep
+ */
+static void* laneWorker(void* arg)
+{
+	lane_pool_t* pool = arg;
+	int l;
+
+	while((l = __atomic_fetch_add(&pool->next, LANE_GROUP, __ATOMIC_RELAXED)) <
+	      pool->count) {
+		int group = pool->count - l < LANE_GROUP ? pool->count - l : LANE_GROUP;
+
+		for(size_t i = 0; i < pool->length; i += LOCKSTEP_BATCH) {
+			size_t n = pool->length - i;
+			simulateLockstep(&pool->lanes[l], group, pool->trace + i,
+			                 n < LOCKSTEP_BATCH ? n : LOCKSTEP_BATCH);
+		}
+	}
+	return NULL;
+}
+
+void simulateLanes(cache_lane_t* lanes, int count, const access_t* trace,
+                   size_t length, int threads)
+{
+	lane_pool_t pool = { lanes, count, 0, trace, length };
+	pthread_t tids[threads];
+	int started = 0;
+
+	//if threads can't be had, the calling thread does the rest
+	while(started < threads - 1 &&
+	      pthread_create(&tids[started], NULL, laneWorker, &pool) == 0)
+		started++;
+	laneWorker(&pool);
+	for(int t = 0; t < started; t++)
+		pthread_join(tids[t], NULL);
+}
+
+
+/*
+ * clearStats - start counting afresh, e.g. once a warm-up is over
+ */
+void clearStats(cache_t* cache)
+{
+	cache->miss_count = 0;
+	cache->hit_count = 0;
+	cache->eviction_count = 0;
+	cache->straddle_count = 0;
+	cache->sub_miss_count = 0;
+	cache->fill_bytes = 0;
+	cache->writeback_bytes = 0;
+}
+
+
+/*
+ * saveCache - write a snapshot of the cache (see cachesim.h)
+ * The snapshot is written next to path and renamed over it once complete,
+ * so an interrupted save never leaves a truncated snapshot behind.
+ */
+int saveCache(cache_t* cache, const char* path, const cache_resume_t* resume)
+{
+	cache_snapshot_t hdr;
+	size_t nlines = (size_t)cache->S * cache->E;
+	char tmp[4096];
+
+	//a snapshot doesn't say how its sets were indexed or organised
+	if(cache->index.kind != INDEX_BITS || cache->org.kind != ORG_SET) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, CACHE_SNAPSHOT_MAGIC, sizeof(hdr.magic));
+	hdr.version = CACHE_SNAPSHOT_VERSION;
+	hdr.line_size = sizeof(cache_snapshot_line_t);
+	hdr.s = cache->s;
+	hdr.E = cache->E;
+	hdr.b = cache->b;
+	hdr.hit_count = cache->hit_count;
+	hdr.miss_count = cache->miss_count;
+	hdr.eviction_count = cache->eviction_count;
+	hdr.lines_offset = sizeof(hdr);
+
+	if(resume) {
+		hdr.trace_offset = resume->trace_offset;
+		hdr.trace_check = resume->trace_check;
+		hdr.trace_check_len = resume->trace_check_len;
+		hdr.trace_records = resume->trace_records;
+		hdr.warmup_left = resume->warmup_left;
+	}
+
+	if(snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	FILE* fp = fopen(tmp, "wb");
+	if(!fp)
+		return -1;
+
+	int ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1;
+	for(size_t i = 0; ok && i < nlines; i++) {
+		cache_snapshot_line_t line;
+
+		memset(&line, 0, sizeof(line));
+		line.tag = cache->lines[i].tag;
+		line.counter = cache->lines[i].counter;
+		line.valid = cache->lines[i].valid == '1';
+		ok = fwrite(&line, sizeof(line), 1, fp) == 1;
+	}
+
+	if(fclose(fp) != 0)
+		ok = 0;
+	if(!ok || rename(tmp, path) != 0) {
+		int err = errno;
+		unlink(tmp);
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+
+/*
+ * loadCache - initialize cache from a snapshot written by saveCache()
+ * The file is mapped rather than read, so even a large cache is restored
+ * with a single copy of its lines.
+ */
+int loadCache(cache_t* cache, const char* path, cache_resume_t* resume)
+{
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+
+	if(fd < 0)
+		return -1;
+	if(fstat(fd, &st) != 0 || st.st_size < CACHE_SNAPSHOT_V1_SIZE) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	char* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+		return -1;
+
+	cache_snapshot_t* hdr = (cache_snapshot_t*)map;
+	cache_snapshot_t v1;
+
+	//a version 1 header stops short of the resume fields
+	if(hdr->version == 1) {
+		memset(&v1, 0, sizeof(v1));
+		memcpy(&v1, map, CACHE_SNAPSHOT_V1_SIZE);
+		hdr = &v1;
+	} else if((size_t)st.st_size < sizeof(cache_snapshot_t)) {
+		munmap(map, st.st_size);
+		errno = EINVAL;
+		return -1;
+	}
+
+	//refuse anything we didn't write, or that is cut short
+	if(memcmp(hdr->magic, CACHE_SNAPSHOT_MAGIC, sizeof(hdr->magic)) != 0 ||
+	   hdr->version < 1 || hdr->version > CACHE_SNAPSHOT_VERSION ||
+	   hdr->line_size != sizeof(cache_snapshot_line_t) ||
+	   hdr->s < 0 || hdr->s > 30 || hdr->b < 0 || hdr->b > 30 ||
+	   hdr->E < 1 || hdr->s + hdr->b > 63 ||
+	   hdr->lines_offset > (uint64_t)st.st_size ||
+	   ((uint64_t)st.st_size - hdr->lines_offset) / sizeof(cache_snapshot_line_t)
+	       < ((uint64_t)hdr->E << hdr->s)) {
+		munmap(map, st.st_size);
+		errno = EINVAL;
+		return -1;
+	}
+
+	initCache(cache, hdr->s, hdr->E, hdr->b);
+	cache->hit_count = hdr->hit_count;
+	cache->miss_count = hdr->miss_count;
+	cache->eviction_count = hdr->eviction_count;
+
+	cache_snapshot_line_t* lines =
+		(cache_snapshot_line_t*)(map + hdr->lines_offset);
+	size_t nlines = (size_t)cache->S * cache->E;
+
+	for(size_t i = 0; i < nlines; i++) {
+		cache->lines[i].tag = lines[i].tag;
+
+		//before version 3, tags left out the set index
+		if(hdr->version < 3)
+			cache->lines[i].tag = lines[i].tag << hdr->s | i / cache->E;
+		cache->lines[i].counter = lines[i].counter;
+		cache->lines[i].valid = lines[i].valid ? '1' : '0';
+	}
+
+	if(resume) {
+		resume->trace_offset = hdr->trace_offset;
+		resume->trace_check = hdr->trace_check;
+		resume->trace_check_len = hdr->trace_check_len;
+		resume->trace_records = hdr->trace_records;
+		resume->warmup_left = hdr->warmup_left;
+	}
+
+	munmap(map, st.st_size);
+	return 0;
+}
+
+
+/*
+ * initSharedCache - allocate a cache that several threads can access
+ * One lock per set, up to MAX_STRIPES locks shared round-robin by the sets.
+ */
+void initSharedCache(shared_cache_t* shared, int s, int E, int b)
+{
+	initCache(&shared->cache, s, E, b);
+
+	shared->nstripes = shared->cache.S < MAX_STRIPES ? shared->cache.S
+	                                                 : MAX_STRIPES;
+	if(posix_memalign((void**)&shared->stripes, sizeof(cache_stripe_t),
+	                  shared->nstripes * sizeof(cache_stripe_t)) != 0) {
+		fprintf(stderr, "initSharedCache: out of memory\n");
+		exit(1);
+	}
+	for(int i = 0; i < shared->nstripes; i++)
+		pthread_spin_init(&shared->stripes[i].lock, PTHREAD_PROCESS_PRIVATE);
+
+	pthread_mutex_init(&shared->threads_lock, NULL);
+	shared->threads = NULL;
+}
+
+
+/*
+ * freeSharedCache - free the cache, its locks and every thread's counters
+ * No thread may still be accessing it.
+ */
+void freeSharedCache(shared_cache_t* shared)
+{
+	for(int i = 0; i < shared->nstripes; i++)
+		pthread_spin_destroy(&shared->stripes[i].lock);
+	free(shared->stripes);
+
+	while(shared->threads) {
+		cache_thread_t* t = shared->threads;
+		shared->threads = t->next;
+		free(t);
+	}
+	pthread_mutex_destroy(&shared->threads_lock);
+
+	freeCache(&shared->cache);
+}
+
+
+/*
+ * attachSharedCache - give the calling thread its own counters
+ * The counters stay with the shared cache until freeSharedCache(), so the
+ * statistics of threads that have finished are not lost.
+ */
+cache_thread_t* attachSharedCache(shared_cache_t* shared)
+{
+	cache_thread_t* t;
+
+	if(posix_memalign((void**)&t, sizeof(cache_thread_t),
+	                  sizeof(cache_thread_t)) != 0) {
+		fprintf(stderr, "attachSharedCache: out of memory\n");
+		exit(1);
+	}
+	memset(t, 0, sizeof(cache_thread_t));
+
+	pthread_mutex_lock(&shared->threads_lock);
+	t->next = shared->threads;
+	shared->threads = t;
+	pthread_mutex_unlock(&shared->threads_lock);
+	return t;
+}
+
+
+/*
+ * sharedAccessData - accessData() for a shared cache
+ * Only the target set is locked; the outcome is counted in the calling
+ * thread's own counters.
+ */
+void sharedAccessData(shared_cache_t* shared, cache_thread_t* thread,
+                      mem_addr_t addr)
+{
+	cache_t* cache = &shared->cache;
+	mem_addr_t targSet = setIndex(cache, addr);
+	mem_addr_t targTag = addr >> cache->b;
+	pthread_spinlock_t* lock =
+		&shared->stripes[targSet & (shared->nstripes - 1)].lock;
+
+	pthread_spin_lock(lock);
+	int result = accessSet(cache->sets[targSet], cache->E, targTag);
+	pthread_spin_unlock(lock);
+
+	//single writer, so a plain increment published atomically is enough
+	if(result == CACHE_HIT) {
+		__atomic_store_n(&thread->hit_count, thread->hit_count + 1,
+		                 __ATOMIC_RELAXED);
+	} else {
+		__atomic_store_n(&thread->miss_count, thread->miss_count + 1,
+		                 __ATOMIC_RELAXED);
+		if(result & CACHE_EVICT)
+			__atomic_store_n(&thread->eviction_count,
+			                 thread->eviction_count + 1, __ATOMIC_RELAXED);
+	}
+}
+
+
+/*
+ * sharedAccessSpan - spanAccess() for a shared cache
+ * Every block the record touches is accessed once, twice for a modify; a
+ * record split across blocks is counted as a straddle of the calling thread.
+ */
+void sharedAccessSpan(shared_cache_t* shared, cache_thread_t* thread, char op,
+                      mem_addr_t addr, unsigned int len)
+{
+	int b = shared->cache.b;
+	mem_addr_t last = addr + (len ? len - 1 : 0);
+
+	if(__builtin_expect(((addr ^ last) >> b) == 0, 1)) {
+		sharedAccessData(shared, thread, addr);
+		if(op == 'M')
+			sharedAccessData(shared, thread, addr);
+		return;
+	}
+
+	__atomic_store_n(&thread->straddle_count, thread->straddle_count + 1,
+	                 __ATOMIC_RELAXED);
+	for(mem_addr_t block = addr >> b; block <= last >> b; block++) {
+		sharedAccessData(shared, thread, block << b);
+		if(op == 'M')
+			sharedAccessData(shared, thread, block << b);
+	}
+}
+
+
+/*
+ * sharedCacheStats - merge the counters of every attached thread
+ * May be called while other threads are still accessing the cache.
+ */
+void sharedCacheStats(shared_cache_t* shared, int* hits, int* misses,
+                      int* evictions, int* straddles)
+{
+	*hits = *misses = *evictions = *straddles = 0;
+
+	pthread_mutex_lock(&shared->threads_lock);
+	for(cache_thread_t* t = shared->threads; t; t = t->next) {
+		*hits += __atomic_load_n(&t->hit_count, __ATOMIC_RELAXED);
+		*misses += __atomic_load_n(&t->miss_count, __ATOMIC_RELAXED);
+		*evictions += __atomic_load_n(&t->eviction_count, __ATOMIC_RELAXED);
+		*straddles += __atomic_load_n(&t->straddle_count, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&shared->threads_lock);
+}
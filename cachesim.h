@@ -0,0 +1,374 @@
+/*
+ * cachesim.h - The cache simulator core used by csim, as a library
+ *
+ * A cache_t is a single-threaded simulated LRU cache.  A shared_cache_t
+ * wraps one so that several threads (for example one per instrumented
+ * producer) can feed the same simulated cache at once: every set is guarded
+ * by one of a number of striped locks, and each thread counts its own hits,
+ * misses and evictions, which are only summed up when they are read.
+ *
+ * Files including this header must enable POSIX declarations (for example
+ * by defining _POSIX_C_SOURCE 200809L) before any system header.
+ */
+#ifndef CACHESIM_H
+#define CACHESIM_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+/* Type: Memory address
+  */
+typedef unsigned long long int mem_addr_t;
+
+/* Type: Cache line
+ *
+ * A structure for representing a line in a cache, contains a counter for
+ * tracking which line is the least recently used.
+ */
+typedef struct cache_line {
+   	 char valid;
+   	 mem_addr_t tag;
+	 int64_t counter; // 64 bits, as a skewed cache keeps its clock in it
+} cache_line_t;
+
+typedef cache_line_t* cache_set_t;
+
+/* Type: Set index function
+ *
+ * How an address picks its set.  The classic cache takes the s address
+ * bits above the block offset; real last-level caches hash the address
+ * instead, so that power-of-two strides don't all pile into a few sets:
+ *
+ *   bits            address bits b .. b+s-1 (the default)
+ *   xor             the block address folded onto s bits by XOR
+ *   prime[:N]       block address modulo N sets (any N, default the
+ *                   largest prime below 2^s)
+ *   matrix:M1,...   set bit i is the parity of the address bits in Mi
+ *                   (hex), one mask per set bit
+ *   slice[:n]       2^n slices chosen by the published Intel Sandy Bridge
+ *                   to Haswell slice hash, 2^(s-n) sets each indexed by
+ *                   the low block address bits (n at most 3, default 3)
+ *
+ * None of them branches on the address.  Whatever the index function,
+ * lines are tagged with their whole block address, so lines of different
+ * blocks never compare equal.
+ */
+typedef enum index_kind {
+	INDEX_BITS = 0,
+	INDEX_XOR,
+	INDEX_MOD,
+	INDEX_MATRIX,
+	INDEX_SLICE
+} index_kind_t;
+
+typedef struct cache_index {
+	index_kind_t kind;
+	int sets;              // mod: number of sets
+	int rows;              // matrix and slice: bits computed as parities
+	uint64_t masks[64];    // ...each of the address bits in its mask
+} cache_index_t;
+
+/* Type: Cache organisation
+ *
+ * Which lines a block may go to.  A set-associative cache offers it the E
+ * ways of one set, so blocks that share a set keep evicting each other
+ * however empty the rest of the cache is.  A skewed-associative cache
+ * (Seznec, ISCA 1993) indexes every way with a hash of its own, so blocks
+ * that collide in one way seldom collide in the others.  A zcache (Sanchez
+ * and Kozyrakis, MICRO 2010) hashes its ways the same way, but on a miss
+ * also walks the other rows the blocks in those lines could move to, and
+ * relocates blocks along the path to the victim it picks, choosing among
+ * many more candidates than it has ways:
+ *
+ *   set            the E ways of one set (the default)
+ *   skew           one hash per way
+ *   zcache[:L]     one hash per way and an L level walk (default 2)
+ *
+ * The last two may be followed by ",lru" (the default) or ",rrip" for
+ * their victim selection.  As no set groups their lines, they are stored
+ * way after way: line w*S+i is row i of way w.  Each line's counter then
+ * holds the time of its last use on a clock kept by the whole cache (lru)
+ * or a 2 bit re-reference prediction value (rrip, as SRRIP).
+ */
+typedef enum org_kind {
+	ORG_SET = 0,
+	ORG_SKEW,
+	ORG_ZCACHE
+} org_kind_t;
+
+typedef enum victim_kind {
+	VICTIM_LRU = 0,
+	VICTIM_RRIP
+} victim_kind_t;
+
+/* Most ways of a skewed cache or zcache, and most candidates of a walk */
+#define SKEW_MAX_WAYS 64
+#define ZCACHE_MAX_WALK 1024
+
+typedef struct cache_org {
+	org_kind_t kind;
+	victim_kind_t victim;
+	int levels;            // levels of the walk, 1 for skew
+} cache_org_t;
+
+/* Type: Cache
+ *
+ * One simulated cache: its geometry, its sets and the counters used to
+ * record its statistics.  Every function works on an explicit cache, so
+ * several of them can be simulated side by side.
+ */
+typedef struct cache {
+	int s; // set index bits
+	int E; // associativity
+	int b; // block offset bits
+	int S; // number of sets S = 2^s, unless the index function says otherwise
+	int B; // block size (bytes) B = 2^b
+	cache_index_t index;
+	cache_org_t org;
+	cache_set_t* sets;   // NULL unless set-associative
+	cache_line_t* lines; // all S*E lines, set after set (or way after way)
+	mem_addr_t* way_keys; // skew and zcache: the hash of each way
+	uint64_t clock;       // skew and zcache: accesses so far, for lru
+	int sub_bits;         // sector cache: 2^sub_bits sub-blocks per line
+	uint64_t* sub_valid;  // ...the sub-blocks present in each line, NULL
+	uint64_t* sub_dirty;  // ...and stored to, unless it is a sector cache
+
+	int miss_count;
+	int hit_count;
+	int eviction_count;
+	int straddle_count;         // records touching more than one block
+	int sub_miss_count;         // sector cache: misses whose tag hit
+	long long fill_bytes;       // ...bytes fetched into the cache
+	long long writeback_bytes;  // ...dirty bytes written back on evictions
+} cache_t;
+
+/* Type: Memory access
+ *
+ * One decoded trace record: the operation (L/S/M), address and size.
+ */
+typedef struct access {
+	mem_addr_t addr;
+	unsigned int len;
+	char op;
+} access_t;
+
+/* Outcome of a single access, as returned by accessSet() */
+#define CACHE_HIT   0
+#define CACHE_MISS  1
+#define CACHE_EVICT 2 /* always together with CACHE_MISS */
+
+/* Allocate the sets and lines of a cache with the given geometry */
+void initCache(cache_t* cache, int s, int E, int b);
+
+/* The same, with another set index function (NULL for bits) */
+void initIndexedCache(cache_t* cache, int s, int E, int b,
+                      const cache_index_t* index);
+
+/* Parse a set index function for 2^s sets; -1 if it isn't one */
+int parseCacheIndex(cache_index_t* index, const char* spec, int s);
+
+/* The same, for a skewed cache or zcache organisation (NULL or ORG_SET
+ * for a set-associative cache) */
+void initSkewedCache(cache_t* cache, int s, int E, int b,
+                     const cache_org_t* org);
+
+/* Parse an organisation for 2^s rows of E ways; -1 if it isn't one */
+int parseCacheOrg(cache_org_t* org, const char* spec, int s, int E);
+
+/*
+ * A sector cache: each line holds a sector of 2^sub_bits sub-blocks of
+ * 2^(b-sub_bits) bytes under one tag, every sub-block with its own valid and
+ * dirty bit (sub_bits at most 6, and at most b).  Only the sub-block accessed
+ * is fetched, whether its sector's tag missed or hit; a tag miss evicts a
+ * whole sector and writes its dirty sub-blocks back.  Stores allocate.
+ * simulateAccess() counts hits, misses (including sub-block misses, also
+ * counted apart) and the bytes moved; with sub_bits 0 it is a plain cache
+ * that also counts its write-backs.
+ */
+void initSectorCache(cache_t* cache, int s, int E, int b, int sub_bits,
+                     const cache_index_t* index);
+
+/* Access len bytes from addr, within one line of a sector cache, loading
+ * or storing */
+void accessSector(cache_t* cache, mem_addr_t addr, unsigned int len, int store);
+
+/* Free everything allocated by initCache() */
+void freeCache(cache_t* cache);
+
+/* Access one address, updating the cache's counters */
+void accessData(cache_t* cache, mem_addr_t addr);
+
+/* Look up tag (a block address) in one set of E lines and update its LRU
+ * state */
+int accessSet(cache_set_t set, int E, mem_addr_t tag);
+
+/* Simulate one trace record: L and S access once, M twice (as a load and a
+ * store, which only a sector cache tells apart) */
+void simulateAccess(cache_t* cache, char op, mem_addr_t addr);
+
+/* The same for a record of len bytes (0 counts as 1): a record straddling
+ * blocks accesses each of them in turn and is counted in straddle_count */
+void simulateSpan(cache_t* cache, char op, mem_addr_t addr, unsigned int len);
+
+/* Zero the hit, miss, eviction and byte counters, keeping the contents */
+void clearStats(cache_t* cache);
+
+
+/* Lockstep simulation
+ *
+ * Several caches can be fed the same decoded accesses in one pass, each
+ * through its own address map, to compare configurations (geometries,
+ * data layouts, address translations...) without decoding a trace once
+ * per configuration.  Each batch is run through one lane after another,
+ * so every cache stays hot in the host's cache for a whole batch.
+ */
+
+/* Where an address ends up in one configuration */
+typedef mem_addr_t (*addr_map_t)(void* arg, mem_addr_t addr);
+
+typedef struct cache_lane {
+	cache_t cache;
+	addr_map_t map;  // NULL for the addresses as recorded
+	void* map_arg;
+} cache_lane_t;
+
+/* Simulate a batch of accesses on each of count lanes, like simulateSpan()
+ * but on the mapped addresses: a record straddles the blocks its bytes land
+ * in once mapped */
+void simulateLockstep(cache_lane_t* lanes, int count, const access_t* batch,
+                      int n);
+
+/*
+ * Simulate a whole in-memory trace on each of count lanes, spreading the
+ * lanes over a pool of threads that each run a few of them in lockstep.
+ */
+void simulateLanes(cache_lane_t* lanes, int count, const access_t* trace,
+                   size_t length, int threads);
+
+
+/* Cache snapshots
+ *
+ * saveCache() writes the complete state of a cache (geometry, counters and
+ * every line with its LRU counter) to a file, loadCache() builds a cache
+ * from one.  The file is a fixed header followed, at lines_offset, by the
+ * S*E lines set after set in a fixed 16 byte layout, so it can be mapped
+ * and indexed directly.  The version changes whenever the layout does;
+ * version 1 snapshots (without the resume fields) and version 2 ones
+ * (whose tags leave out the set index bits) are still accepted.  Only
+ * caches with the default set index function and organisation can be
+ * saved.
+ *
+ * A snapshot can also record where in a trace the cache state was taken
+ * (see cache_resume_t), so that a later run can pick up from there.
+ */
+#define CACHE_SNAPSHOT_MAGIC   "CSIMSNAP"
+#define CACHE_SNAPSHOT_VERSION 3
+
+typedef struct cache_snapshot {
+	char magic[8];
+	uint32_t version;
+	uint32_t line_size;     /* sizeof(cache_snapshot_line_t) */
+	int32_t s, E, b;
+	int32_t reserved;
+	int64_t hit_count;
+	int64_t miss_count;
+	int64_t eviction_count;
+	uint64_t lines_offset;  /* file offset of the first line */
+	/* version 2 */
+	uint64_t trace_offset;
+	uint64_t trace_check;
+	uint32_t trace_check_len;
+	uint32_t reserved2;
+	int64_t trace_records;
+	int64_t warmup_left;
+} cache_snapshot_t;
+
+/* Size of a version 1 header, which ends at lines_offset */
+#define CACHE_SNAPSHOT_V1_SIZE 64
+
+typedef struct cache_snapshot_line {
+	uint64_t tag;
+	int32_t counter;
+	uint8_t valid;          /* 0 or 1 */
+	uint8_t pad[3];
+} cache_snapshot_line_t;
+
+/* Type: Trace position
+ *
+ * Where a snapshot was taken in its trace: the byte offset just after the
+ * last record replayed, a hash of the last check_len bytes before it (to
+ * notice a trace that was rewritten rather than appended to), the number of
+ * records replayed and how much of the warm-up was still left.
+ */
+typedef struct cache_resume {
+	uint64_t trace_offset;
+	uint64_t trace_check;
+	uint32_t trace_check_len;
+	int64_t trace_records;
+	int64_t warmup_left;
+} cache_resume_t;
+
+/* Write cache (and optionally its trace position) to path, atomically via
+ * a temporary file; -1 on error */
+int saveCache(cache_t* cache, const char* path, const cache_resume_t* resume);
+
+/* Initialize cache from a snapshot written by saveCache(), filling in
+ * resume if it isn't NULL; -1 on error */
+int loadCache(cache_t* cache, const char* path, cache_resume_t* resume);
+
+/* Type: Per-thread statistics of a shared cache
+ *
+ * Only the owning thread writes these, so counting needs no atomic
+ * read-modify-write; the alignment keeps two threads' counters off the same
+ * hardware cache line.
+ */
+typedef struct cache_thread {
+	int miss_count;
+	int hit_count;
+	int eviction_count;
+	int straddle_count;
+	struct cache_thread* next;
+} __attribute__((aligned(64))) cache_thread_t;
+
+/* One set lock, alone on its hardware cache line */
+typedef struct cache_stripe {
+	pthread_spinlock_t lock;
+} __attribute__((aligned(64))) cache_stripe_t;
+
+/* Type: Shared cache
+ *
+ * A cache that several threads access concurrently.  Set i is guarded by
+ * stripes[i & (nstripes - 1)], so threads touching different sets rarely
+ * contend.
+ */
+typedef struct shared_cache {
+	cache_t cache;
+	int nstripes;
+	cache_stripe_t* stripes;
+
+	pthread_mutex_t threads_lock;
+	cache_thread_t* threads;
+} shared_cache_t;
+
+/* Allocate a shared cache; its counters start at zero */
+void initSharedCache(shared_cache_t* shared, int s, int E, int b);
+
+/* Free a shared cache together with all of its threads' counters */
+void freeSharedCache(shared_cache_t* shared);
+
+/* Register the calling thread, returns the counters it must pass along */
+cache_thread_t* attachSharedCache(shared_cache_t* shared);
+
+/* Access one address on behalf of thread, safe to call concurrently */
+void sharedAccessData(shared_cache_t* shared, cache_thread_t* thread,
+                      mem_addr_t addr);
+
+/* simulateSpan() for a shared cache, safe to call concurrently */
+void sharedAccessSpan(shared_cache_t* shared, cache_thread_t* thread, char op,
+                      mem_addr_t addr, unsigned int len);
+
+/* Sum all threads' counters */
+void sharedCacheStats(shared_cache_t* shared, int* hits, int* misses,
+                      int* evictions, int* straddles);
+
+#endif /* CACHESIM_H */
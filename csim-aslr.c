@@ -0,0 +1,249 @@
+/*
+ * csim-aslr.c - How much do a trace's misses depend on where its regions
+ *     happen to be placed?  The trace is replayed under many random
+ *     relocations of its regions, like the ones address space layout
+ *     randomization and the allocator make from run to run, and the
+ *     spread of the misses and evictions is reported.
+ *
+ * Regions are given with -R or found by clustering the trace's addresses
+ * (see region.h).  In every trial each region moves by its own random
+ * multiple of the alignment (a page by default, 1 for arbitrary
+ * placement) within a window; placements where two regions would overlap
+ * are drawn again.  All trials are simulated at once, in
+ * lockstep lanes spread over a pool of threads (see cachesim.h).
+ *
+ * Usage: csim-aslr [-h] -s <num> -E <num> -b <num> -t <file> [-R <lo-hi> ...]
+ *                  [-n <trials>] [--align <bytes>] [--window <bytes>]
+ *                  [--seed <num>] [-j <threads>]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "cachesim.h"
+#include "trace.h"
+#include "region.h"
+#include "random.h"
+
+#define DEFAULT_TRIALS 100
+#define DEFAULT_ALIGN 4096
+#define DEFAULT_WINDOW (1 << 20)
+/* Most trials in one run */
+#define MAX_TRIALS 100000
+/* Draws of one placement before giving up on one without overlaps */
+#define MAX_DRAWS 1000
+
+
+static int byCount(const void* x, const void* y)
+{
+    int a = *(const int*)x;
+    int b = *(const int*)y;
+
+    return a < b ? -1 : a > b;
+}
+
+/*
+ * printSpread - min, median, 99th percentile (nearest rank) and max
+ */
+static void printSpread(const char* what, int* v, int n)
+{
+    qsort(v, n, sizeof(int), byCount);
+    printf("%-10s %10d %10d %10d %10d\n", what, v[0], v[n / 2],
+           v[(99 * n + 99) / 100 - 1], v[n - 1]);
+}
+
+
+/*
+ * printUsage - Print usage info
+ */
+void printUsage(char* argv[])
+{
+    printf("Usage: %s [-h] -s <num> -E <num> -b <num> -t <file> [-R <lo-hi> ...]\n"
+           "          [-n <trials>] [--align <bytes>] [--window <bytes>]\n"
+           "          [--seed <num>] [-j <threads>]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h         Print this help message.\n");
+    printf("  -s <num>   Number of set index bits.\n");
+    printf("  -E <num>   Number of lines per set.\n");
+    printf("  -b <num>   Number of block offset bits.\n");
+    printf("  -t <file>  Trace file.\n");
+    printf("  --format <fmt>  Trace format (default: detected).\n");
+    printf("  -R <lo-hi> A region (hex addresses, hi exclusive); repeat for\n"
+           "             more.  Without -R, regions are found in the trace.\n");
+    printf("  --gap <bytes>     Distance that separates found regions (default %d).\n",
+           REGION_GAP);
+    printf("  -n <num>   Number of random placements (default %d).\n", DEFAULT_TRIALS);
+    printf("  --align <bytes>   Alignment of the moves, 1 for arbitrary (default %d).\n",
+           DEFAULT_ALIGN);
+    printf("  --window <bytes>  Moves are less than this (default %d).\n",
+           DEFAULT_WINDOW);
+    printf("  --seed <num>      Random seed (default 1).\n");
+    printf("  -j <num>   Number of threads (default: one per CPU).\n");
+    printf("\nExample:\n");
+    printf("  linux>  %s -s 5 -E 1 -b 5 -t traces/long.trace -n 1000 --align 1\n",
+           argv[0]);
+}
+
+int main(int argc, char* argv[])
+{
+    enum { OPT_FORMAT = 256, OPT_GAP, OPT_ALIGN, OPT_WINDOW, OPT_SEED };
+    static struct option long_options[] = {
+        {"format", required_argument, NULL, OPT_FORMAT},
+        {"gap",    required_argument, NULL, OPT_GAP},
+        {"align",  required_argument, NULL, OPT_ALIGN},
+        {"window", required_argument, NULL, OPT_WINDOW},
+        {"seed",   required_argument, NULL, OPT_SEED},
+        {NULL, 0, NULL, 0}
+    };
+    region_t regions[MAX_REGIONS];
+    int region_count = 0;
+    trace_format_t format = TRACE_AUTO;
+    char* trace_file = NULL;
+    mem_addr_t gap = REGION_GAP, align = DEFAULT_ALIGN, window = DEFAULT_WINDOW;
+    uint64_t seed = 1;
+    int s = -1, E = -1, b = -1;
+    int trials = DEFAULT_TRIALS;
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int c;
+
+    while((c = getopt_long(argc, argv, "s:E:b:t:R:n:j:h", long_options, NULL)) != -1) {
+        switch(c) {
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 't':
+            trace_file = optarg;
+            break;
+        case 'R':
+            if(region_count == MAX_REGIONS ||
+               parseRegion(&regions[region_count], optarg) != 0) {
+                printf("%s: bad region %s\n", argv[0], optarg);
+                exit(1);
+            }
+            region_count++;
+            break;
+        case 'n':
+            trials = atoi(optarg);
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case OPT_FORMAT:
+            format = parseTraceFormat(optarg);
+            if((int)format < 0) {
+                printf("%s: unknown trace format %s\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case OPT_GAP:
+            gap = strtoull(optarg, NULL, 0);
+            break;
+        case OPT_ALIGN:
+            align = strtoull(optarg, NULL, 0);
+            break;
+        case OPT_WINDOW:
+            window = strtoull(optarg, NULL, 0);
+            break;
+        case OPT_SEED:
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'h':
+            printUsage(argv);
+            exit(0);
+        default:
+            printUsage(argv);
+            exit(1);
+        }
+    }
+
+    if(s < 0 || E < 1 || b < 0 || !trace_file) {
+        printf("%s: Missing required command line argument\n", argv[0]);
+        printUsage(argv);
+        exit(1);
+    }
+    if(trials < 1 || trials > MAX_TRIALS || align < 1 || window < align) {
+        printf("%s: invalid number of trials, alignment or window\n", argv[0]);
+        exit(1);
+    }
+    if(threads < 1)
+        threads = 1;
+
+    size_t length;
+    access_t* trace = loadTrace(trace_file, format, &length);
+    if(!trace) {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], trace_file, strerror(errno));
+        exit(1);
+    }
+
+    region_count = traceRegions(regions, region_count, trace, length, gap);
+    if(region_count < 0) {
+        printf("%s: %s\n", argv[0],
+               errno == EINVAL ? "regions overlap" : strerror(errno));
+        exit(1);
+    }
+
+    //lane 0 replays the trace as recorded, the others one placement each
+    region_shift_t* shifts = calloc(trials + 1, sizeof(region_shift_t));
+    cache_lane_t* lanes = calloc(trials + 1, sizeof(cache_lane_t));
+    uint64_t state = seed ? seed : 1;
+
+    if(!shifts || !lanes) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        exit(1);
+    }
+    for(int l = 0; l <= trials; l++) {
+        shifts[l].count = region_count;
+        shifts[l].regions = regions;
+        for(int draws = 0; l > 0; draws++) {
+            if(draws == MAX_DRAWS) {
+                printf("%s: no placement without overlapping regions found, "
+                       "try a larger --window\n", argv[0]);
+                exit(1);
+            }
+            for(int g = 0; g < region_count; g++)
+                shifts[l].offsets[g] = randomBelow(&state, window / align) * align;
+            if(!shiftOverlaps(&shifts[l]))
+                break;
+        }
+
+        initCache(&lanes[l].cache, s, E, b);
+        lanes[l].map = shiftRegions;
+        lanes[l].map_arg = &shifts[l];
+    }
+
+    simulateLanes(lanes, trials + 1, trace, length, threads);
+
+    int* misses = malloc(trials * sizeof(int));
+    int* evictions = malloc(trials * sizeof(int));
+    for(int l = 1; l <= trials; l++) {
+        misses[l-1] = lanes[l].cache.miss_count;
+        evictions[l-1] = lanes[l].cache.eviction_count;
+    }
+
+    printf("%d placements of %d regions, moved by multiples of %llu below %llu\n",
+           trials, region_count, align, window);
+    printf("As traced: misses=%d evictions=%d\n\n", lanes[0].cache.miss_count,
+           lanes[0].cache.eviction_count);
+    printf("%-10s %10s %10s %10s %10s\n", "", "min", "median", "p99", "max");
+    printSpread("misses", misses, trials);
+    printSpread("evictions", evictions, trials);
+
+    for(int l = 0; l <= trials; l++)
+        freeCache(&lanes[l].cache);
+    free(misses);
+    free(evictions);
+    free(lanes);
+    free(shifts);
+    free(trace);
+    return 0;
+}
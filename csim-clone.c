@@ -0,0 +1,217 @@
+/*
+ * csim-clone.c - Profile a trace and generate a much shorter synthetic
+ *     proxy of it (see profile.h), checking that the proxy's miss ratio
+ *     curve stays within a stated error of the original's.
+ *
+ * The profile can be saved and the proxy made from it later, so a trace
+ * that can't be kept can still be stood in for by its profile.
+ *
+ * The curves are compared for fully associative LRU caches of 1, 2, 4, ...
+ * lines, up to a sixteenth of the proxy's length: a proxy can't reuse a
+ * line at a distance of more lines than it has accesses.
+ *
+ * Usage: csim-clone [-h] (-t <file> | -p <profile>) [-b <num>] [-r <ratio>]
+ *                   [-o <file>] [--format <fmt>] [--save-profile <file>]
+ *                   [--max-error <num>] [--seed <num>]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "cachesim.h"
+#include "trace.h"
+#include "profile.h"
+#include "region.h"
+
+#define DEFAULT_B 6
+#define DEFAULT_RATIO 100
+/* The curves are compared up to caches of (proxy length / MRC_REACH) lines */
+#define MRC_REACH 16
+
+/*
+ * printUsage - Print usage info
+ */
+void printUsage(char* argv[])
+{
+    printf("Usage: %s [-h] (-t <file> | -p <profile>) [-b <num>] [-r <ratio>]\n"
+           "          [-o <file>] [--format <fmt>] [--save-profile <file>]\n"
+           "          [--max-error <num>] [--seed <num>]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h         Print this help message.\n");
+    printf("  -t <file>  Trace file to profile.\n");
+    printf("  -p <file>  Profile saved earlier, instead of a trace.\n");
+    printf("  -b <num>   Block offset bits of the profile (default %d).\n", DEFAULT_B);
+    printf("  -r <num>   The proxy is this many times shorter (default %d).\n",
+           DEFAULT_RATIO);
+    printf("  -o <file>  Write the proxy trace to <file>.\n");
+    printf("  --format <fmt>        Format of the proxy: lackey (default),\n"
+           "                        pinatrace, drmemtrace or champsim.\n");
+    printf("  --save-profile <file> Save the trace's profile to <file>.\n");
+    printf("  --max-error <num>     Fail unless the miss ratios agree within\n"
+           "                        <num> (absolute, e.g. 0.02).\n");
+    printf("  --seed <num>          Random seed (default 1).\n");
+    printf("\nExample:\n");
+    printf("  linux>  %s -t traces/long.trace -r 20 -o long.proxy --max-error 0.05\n",
+           argv[0]);
+}
+
+int main(int argc, char* argv[])
+{
+    enum { OPT_FORMAT = 256, OPT_SAVE_PROFILE, OPT_MAX_ERROR, OPT_SEED };
+    static struct option long_options[] = {
+        {"format",       required_argument, NULL, OPT_FORMAT},
+        {"save-profile", required_argument, NULL, OPT_SAVE_PROFILE},
+        {"max-error",    required_argument, NULL, OPT_MAX_ERROR},
+        {"seed",         required_argument, NULL, OPT_SEED},
+        {NULL, 0, NULL, 0}
+    };
+    char* trace_file = NULL;
+    char* profile_file = NULL;
+    char* save_file = NULL;
+    char* out_file = NULL;
+    trace_format_t format = TRACE_LACKEY;
+    double max_error = -1;
+    uint64_t seed = 1;
+    int b = DEFAULT_B, ratio = DEFAULT_RATIO;
+    int c;
+
+    while((c = getopt_long(argc, argv, "t:p:b:r:o:h", long_options, NULL)) != -1) {
+        switch(c) {
+        case 't':
+            trace_file = optarg;
+            break;
+        case 'p':
+            profile_file = optarg;
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 'r':
+            ratio = atoi(optarg);
+            break;
+        case 'o':
+            out_file = optarg;
+            break;
+        case OPT_FORMAT:
+            format = parseTraceFormat(optarg);
+            if((int)format <= TRACE_AUTO) {
+                printf("%s: unknown trace format %s\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case OPT_SAVE_PROFILE:
+            save_file = optarg;
+            break;
+        case OPT_MAX_ERROR:
+            max_error = atof(optarg);
+            break;
+        case OPT_SEED:
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'h':
+            printUsage(argv);
+            exit(0);
+        default:
+            printUsage(argv);
+            exit(1);
+        }
+    }
+
+    if(!trace_file == !profile_file) {
+        printf("%s: Need exactly one of -t and -p\n", argv[0]);
+        printUsage(argv);
+        exit(1);
+    }
+    if(b < 0 || b > 30 || ratio < 1) {
+        printf("%s: invalid block size or ratio\n", argv[0]);
+        exit(1);
+    }
+
+    profile_t original, cloned;
+
+    if(trace_file) {
+        size_t length;
+        access_t* trace = loadTrace(trace_file, TRACE_AUTO, &length);
+
+        if(!trace) {
+            fprintf(stderr, "%s: %s: %s\n", argv[0], trace_file, strerror(errno));
+            exit(1);
+        }
+        if(profileTrace(&original, trace, length, b, REGION_GAP) != 0) {
+            fprintf(stderr, "%s: out of memory\n", argv[0]);
+            exit(1);
+        }
+        free(trace);
+    } else if(loadProfile(&original, profile_file) != 0) {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], profile_file, strerror(errno));
+        exit(1);
+    }
+
+    if(save_file && saveProfile(&original, save_file) != 0) {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], save_file, strerror(errno));
+        exit(1);
+    }
+
+    size_t length = original.accesses / ratio;
+    if(length == 0) {
+        printf("%s: trace too short for a ratio of %d\n", argv[0], ratio);
+        exit(1);
+    }
+
+    access_t* proxy = cloneTrace(&original, length, seed);
+    if(!proxy || profileTrace(&cloned, proxy, length, original.b, REGION_GAP) != 0) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        exit(1);
+    }
+
+    if(out_file) {
+        trace_writer_t writer;
+
+        if(createTrace(&writer, out_file, format) != 0 ||
+           writeTrace(&writer, proxy, length) != 0 || finishTrace(&writer) != 0) {
+            fprintf(stderr, "%s: %s: %s\n", argv[0], out_file, strerror(errno));
+            exit(1);
+        }
+    }
+
+    //compare the curves where the proxy is long enough to tell
+    double want[MRC_POINTS], got[MRC_POINTS];
+    double error = 0;
+    int points = 0;
+
+    missRatioCurve(&original, want);
+    missRatioCurve(&cloned, got);
+
+    printf("Original: %llu accesses, %llu lines; proxy: %zu accesses, %llu lines\n",
+           (unsigned long long)original.accesses,
+           (unsigned long long)original.footprint, length,
+           (unsigned long long)cloned.footprint);
+    printf("%10s %10s %10s %10s\n", "lines", "original", "proxy", "error");
+    while(points < MRC_POINTS && (1ULL << points) * MRC_REACH <= length) {
+        double e = fabs(want[points] - got[points]);
+
+        printf("%10llu %10.4f %10.4f %10.4f\n", 1ULL << points, want[points],
+               got[points], e);
+        if(e > error)
+            error = e;
+        points++;
+    }
+
+    if(points == 0) {
+        printf("Proxy too short to compare miss ratio curves\n");
+    } else {
+        printf("Miss ratio curve matched within %.4f for caches of up to %llu lines\n",
+               error, 1ULL << (points - 1));
+    }
+
+    free(proxy);
+    if(max_error >= 0 && (points == 0 || error > max_error)) {
+        printf("%s: error above %.4f\n", argv[0], max_error);
+        exit(1);
+    }
+    return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * csim-gen.c - Generate synthetic access streams (see gen.h), either as a
+ *     trace file in any format csim reads, or straight into an in-process
+ *     simulated cache without writing anything.
+ *
+ * Usage: csim-gen [-h] -p <pattern> [options] [-o <file>] [--format <fmt>]
+ *        csim-gen [-h] -p <pattern> [options] -s <num> -E <num> -b <num>
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <getopt.h>
+
+#include "cachesim.h"
+#include "trace.h"
+#include "gen.h"
+
+/*
+ * parseSize - a byte count with an optional K, M or G suffix
+ */
+uint64_t parseSize(const char* arg)
+{
+    char* end;
+    uint64_t n = strtoull(arg, &end, 0);
+
+    switch(*end) {
+    case 'G': case 'g': n <<= 10; /* fall through */
+    case 'M': case 'm': n <<= 10; /* fall through */
+    case 'K': case 'k': n <<= 10;
+    }
+    return n;
+}
+
+/*
+ * printUsage - Print usage info
+ */
+void printUsage(char* argv[])
+{
+    printf("Usage: %s [-h] -p <pattern> [options] [-o <file>] [--format <fmt>]\n", argv[0]);
+    printf("       %s [-h] -p <pattern> [options] -s <num> -E <num> -b <num>\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h         Print this help message.\n");
+    printf("  -p <name>  Pattern: stride, uniform, zipf, chase, stencil2d,\n"
+           "             stencil3d, matmul or hash.\n");
+    printf("  -n <num>   Accesses (lookups for hash, sweeps for stencils and\n"
+           "             matmul) to generate.\n");
+    printf("  -m <size>  Footprint in bytes, K/M/G suffixes allowed (default 1M).\n");
+    printf("  -e <size>  Element size, also the access size (default 8, 64 for chase).\n");
+    printf("  -o <file>  Trace file to write (default: stdout).\n");
+    printf("  --format <fmt>  Trace format: lackey (default), pinatrace,\n"
+           "                  drmemtrace or champsim (which drops access\n"
+           "                  sizes, see trace.h).\n");
+    printf("  -s <num>, -E <num>, -b <num>\n"
+           "             Simulate the stream on this cache instead of writing it.\n");
+    printf("  --stride <size>  Bytes between stride accesses (default: element size).\n");
+    printf("  --alpha <num>    Zipf exponent (default 1.0).\n");
+    printf("  --dims <NXxNYxNZ>  Stencil grid or matmul matrix side (default 256,\n"
+           "                     64 for stencil3d).\n");
+    printf("  --tile <num>     Matmul block side (default 32).\n");
+    printf("  --writes <pct>   Percent of stores for uniform, zipf and hash (default 0).\n");
+    printf("  --base <addr>    First address (default 0x10000000).\n");
+    printf("  --seed <num>     Random seed (default 0).\n");
+    printf("\nExamples:\n");
+    printf("  linux>  %s -p zipf -n 100000 -m 4M --alpha 0.8 -o zipf.trace\n", argv[0]);
+    printf("  linux>  %s -p matmul --dims 128 --tile 16 -s 6 -E 8 -b 6\n", argv[0]);
+}
+
+int main(int argc, char* argv[])
+{
+    enum { OPT_FORMAT = 256, OPT_STRIDE, OPT_ALPHA, OPT_DIMS, OPT_TILE,
+           OPT_WRITES, OPT_BASE, OPT_SEED };
+    static struct option long_options[] = {
+        {"format", required_argument, NULL, OPT_FORMAT},
+        {"stride", required_argument, NULL, OPT_STRIDE},
+        {"alpha",  required_argument, NULL, OPT_ALPHA},
+        {"dims",   required_argument, NULL, OPT_DIMS},
+        {"tile",   required_argument, NULL, OPT_TILE},
+        {"writes", required_argument, NULL, OPT_WRITES},
+        {"base",   required_argument, NULL, OPT_BASE},
+        {"seed",   required_argument, NULL, OPT_SEED},
+        {NULL, 0, NULL, 0}
+    };
+    gen_params_t params;
+    trace_format_t format = TRACE_LACKEY;
+    char* out = "-";
+    int s = -1, E = -1, b = -1;
+    int pattern = -1;
+    int c;
+
+    memset(&params, 0, sizeof(params));
+
+    while((c = getopt_long(argc, argv, "p:n:m:e:o:s:E:b:h", long_options, NULL)) != -1) {
+        switch(c) {
+        case 'p':
+            pattern = parseGenPattern(optarg);
+            if(pattern < 0) {
+                printf("%s: unknown pattern %s\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case 'n':
+            params.count = strtoull(optarg, NULL, 0);
+            break;
+        case 'm':
+            params.footprint = parseSize(optarg);
+            break;
+        case 'e':
+            params.elem = parseSize(optarg);
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case OPT_FORMAT:
+            format = parseTraceFormat(optarg);
+            if((int)format <= TRACE_AUTO) {
+                printf("%s: unknown trace format %s\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case OPT_STRIDE:
+            params.stride = parseSize(optarg);
+            break;
+        case OPT_ALPHA:
+            params.alpha = atof(optarg);
+            break;
+        case OPT_DIMS:
+            sscanf(optarg, "%dx%dx%d", &params.nx, &params.ny, &params.nz);
+            break;
+        case OPT_TILE:
+            params.tile = atoi(optarg);
+            break;
+        case OPT_WRITES:
+            params.writes = atoi(optarg);
+            break;
+        case OPT_BASE:
+            params.base = strtoull(optarg, NULL, 0);
+            break;
+        case OPT_SEED:
+            params.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'h':
+            printUsage(argv);
+            exit(0);
+        default:
+            printUsage(argv);
+            exit(1);
+        }
+    }
+
+    if(pattern < 0) {
+        printf("%s: Missing required command line argument\n", argv[0]);
+        printUsage(argv);
+        exit(1);
+    }
+    params.pattern = pattern;
+
+    //-s, -E and -b all or none
+    int simulate = s >= 0 || E >= 0 || b >= 0;
+    if(simulate && (s < 0 || E < 1 || b < 0)) {
+        printf("%s: -s, -E and -b go together\n", argv[0]);
+        exit(1);
+    }
+
+    gen_t gen;
+    if(initGen(&gen, &params) != 0) {
+        printf("%s: invalid parameters for pattern %s\n", argv[0],
+               genPatternName(params.pattern));
+        exit(1);
+    }
+
+    access_t batch[TRACE_BATCH];
+    int n;
+
+    if(simulate) {
+        cache_t cache;
+
+        //the counters are ints, and an access may touch more than one block
+        uint64_t B = 1ULL << b;
+        uint64_t blocks = (gen.p.elem - 1 + B - 1) / B + 1;
+        if(genLength(&gen) > INT_MAX / blocks) {
+            printf("%s: the stream is too long to count, use a smaller -n\n",
+                   argv[0]);
+            exit(1);
+        }
+
+        initCache(&cache, s, E, b);
+        while((n = genTrace(&gen, batch, TRACE_BATCH)) > 0) {
+            for(int i = 0; i < n; i++)
+                simulateSpan(&cache, batch[i].op, batch[i].addr, batch[i].len);
+        }
+        printf("hits:%d misses:%d evictions:%d\n", cache.hit_count,
+               cache.miss_count, cache.eviction_count);
+        freeCache(&cache);
+    } else {
+        trace_writer_t writer;
+
+        if(createTrace(&writer, out, format) != 0) {
+            fprintf(stderr, "%s: %s: %s\n", argv[0], out, strerror(errno));
+            exit(1);
+        }
+        while((n = genTrace(&gen, batch, TRACE_BATCH)) > 0)
+            writeTrace(&writer, batch, n);
+        if(finishTrace(&writer) != 0) {
+            fprintf(stderr, "%s: %s: %s\n", argv[0], out, strerror(errno));
+            exit(1);
+        }
+    }
+
+    freeGen(&gen);
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * csim-layout.c - Replay a trace once under several memory layouts of its
+ *     matrices (see layout.h), each on its own cache, and compare misses.
+ *
+ * The trace is decoded a batch at a time, and every batch is simulated on
+ * all layouts in lockstep (see simulateLockstep() in cachesim.h).
+ *
+ * Usage: csim-layout [-h] -s <num> -E <num> -b <num> -t <file>
+ *                    -m <base:MxN[:elem]> [-m ...] [-l <layout,...>]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include "cachesim.h"
+#include "trace.h"
+#include "layout.h"
+
+/* Most layouts compared in one run */
+#define MAX_LAYOUTS 32
+
+/*
+ * printUsage - Print usage info
+ */
+void printUsage(char* argv[])
+{
+    printf("Usage: %s [-h] -s <num> -E <num> -b <num> -t <file>\n"
+           "          -m <base:MxN[:elem]> [-m ...] [-l <layout,...>]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h         Print this help message.\n");
+    printf("  -s <num>   Number of set index bits.\n");
+    printf("  -E <num>   Number of lines per set.\n");
+    printf("  -b <num>   Number of block offset bits.\n");
+    printf("  -t <file>  Trace file.\n");
+    printf("  --format <fmt>  Trace format (default: detected).\n");
+    printf("  -m <spec>  A row-major matrix in the trace: hex base address, M\n"
+           "             columns by N rows, elements of elem bytes (default 4).\n");
+    printf("  -l <list>  Layouts to compare: row, padded:<P>, tiled:<W>x<H>,\n"
+           "             morton (default row,padded:8,tiled:8x8,morton).\n");
+    printf("\nExample:\n");
+    printf("  linux>  %s -s 5 -E 1 -b 5 -t trans.trace -m 10000000:64x64 "
+           "-m 10040000:64x64\n", argv[0]);
+}
+
+int main(int argc, char* argv[])
+{
+    enum { OPT_FORMAT = 256 };
+    static struct option long_options[] = {
+        {"format", required_argument, NULL, OPT_FORMAT},
+        {NULL, 0, NULL, 0}
+    };
+    char default_layouts[] = "row,padded:8,tiled:8x8,morton";
+    char* layout_list = default_layouts;
+    char* matrix_specs[MAX_MATRICES];
+    int matrix_count = 0;
+    trace_format_t format = TRACE_AUTO;
+    char* trace_file = NULL;
+    int s = -1, E = -1, b = -1;
+    int c;
+
+    while((c = getopt_long(argc, argv, "s:E:b:t:m:l:h", long_options, NULL)) != -1) {
+        switch(c) {
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 't':
+            trace_file = optarg;
+            break;
+        case 'm':
+            if(matrix_count == MAX_MATRICES) {
+                printf("%s: at most %d matrices\n", argv[0], MAX_MATRICES);
+                exit(1);
+            }
+            matrix_specs[matrix_count++] = optarg;
+            break;
+        case 'l':
+            layout_list = optarg;
+            break;
+        case OPT_FORMAT:
+            format = parseTraceFormat(optarg);
+            if((int)format < 0) {
+                printf("%s: unknown trace format %s\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case 'h':
+            printUsage(argv);
+            exit(0);
+        default:
+            printUsage(argv);
+            exit(1);
+        }
+    }
+
+    if(s < 0 || E < 1 || b < 0 || !trace_file || matrix_count == 0) {
+        printf("%s: Missing required command line argument\n", argv[0]);
+        printUsage(argv);
+        exit(1);
+    }
+
+    //one lane per layout, each knowing every matrix
+    layout_t layouts[MAX_LAYOUTS];
+    cache_lane_t lanes[MAX_LAYOUTS];
+    int count = 0;
+
+    for(char* tok = strtok(layout_list, ","); tok; tok = strtok(NULL, ",")) {
+        if(count == MAX_LAYOUTS || parseLayout(&layouts[count], tok) != 0) {
+            printf("%s: bad layout %s\n", argv[0], tok);
+            exit(1);
+        }
+        for(int i = 0; i < matrix_count; i++) {
+            if(addMatrix(&layouts[count], matrix_specs[i]) != 0) {
+                printf("%s: bad matrix %s\n", argv[0], matrix_specs[i]);
+                exit(1);
+            }
+        }
+        initCache(&lanes[count].cache, s, E, b);
+        lanes[count].map = mapLayout;
+        lanes[count].map_arg = &layouts[count];
+        count++;
+    }
+
+    trace_reader_t reader;
+    access_t batch[TRACE_BATCH];
+    int n;
+
+    if(openTrace(&reader, trace_file, format, 0) != 0) {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], trace_file, strerror(errno));
+        exit(1);
+    }
+    while((n = readTrace(&reader, batch, TRACE_BATCH)) > 0)
+        simulateLockstep(lanes, count, batch, n);
+    closeTrace(&reader);
+
+    printf("%-16s %10s %10s %10s\n", "layout", "hits", "misses", "evictions");
+    for(int l = 0; l < count; l++) {
+        cache_t* cache = &lanes[l].cache;
+
+        printf("%-16s %10d %10d %10d\n", layouts[l].name, cache->hit_count,
+               cache->miss_count, cache->eviction_count);
+        freeCache(cache);
+    }
+    return 0;
+}
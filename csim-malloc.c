@@ -0,0 +1,379 @@
+/*
+ * csim-malloc.c - Allocation recorder, preloaded into a program while it
+ *     is traced so csim can charge heap accesses to allocation sites
+ *
+ * Build libcsim-malloc.so with make, then trace with it preloaded, e.g.
+ *
+ *   linux> LD_PRELOAD=./libcsim-malloc.so valgrind --tool=lackey \
+ *              --trace-mem=yes --log-file=prog.trace ./prog
+ *
+ * (lackey leaves malloc alone, so the preloaded one is used) and pass the
+ * log (CSIM_MALLOC_LOG, csim-malloc.log by default) to csim with
+ * --malloc-log.  Every malloc, calloc, realloc, posix_memalign,
+ * aligned_alloc and free is logged, see alloclog.h for the format.
+ *
+ * A call site is identified by the CSIM_MALLOC_DEPTH (default 3) innermost
+ * return addresses of its call chain, each as an offset into its object so
+ * that the site is the same from run to run, hashed together.  More than
+ * one frame tells apart the callers of allocation wrappers such as
+ * operator new.
+ *
+ * To line the log up with the trace, logging an event loads a marker
+ * variable whose address is in the log's first line: the n-th load of the
+ * marker in the trace is the n-th event.  The recorder's own few accesses
+ * remain in the trace.
+ */
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "alloclog.h"
+
+#define DEFAULT_LOG "csim-malloc.log"
+#define DEFAULT_DEPTH 3
+#define MAX_DEPTH 8
+/* Frames of the recorder itself at most, on top of every call chain */
+#define RECORDER_FRAMES 4
+/* Bytes of log buffered before they are written out */
+#define LOG_BUFFER 65536
+/* Call sites remembered as already described in the log */
+#define SITE_SLOTS 4096
+/* Memory handed out while the real allocator is being looked up */
+#define BOOT_ARENA 65536
+
+static void* (*real_malloc)(size_t);
+static void* (*real_calloc)(size_t, size_t);
+static void* (*real_realloc)(void*, size_t);
+static void (*real_free)(void*);
+static int (*real_posix_memalign)(void**, size_t, size_t);
+static void* (*real_aligned_alloc)(size_t, size_t);
+
+static int state = 0; // 0 before init(), 1 while looking up, 2 recording
+static int log_fd = -1;
+static int depth = DEFAULT_DEPTH;
+
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static char log_buf[LOG_BUFFER];
+static size_t log_len = 0;
+static uint64_t sites_seen[SITE_SLOTS];
+
+/* Loaded once per event, so the trace carries the event clock */
+static volatile uint64_t event_marker;
+
+/* Set while the recorder itself allocates, which isn't logged */
+static __thread int busy = 0;
+
+static char boot_arena[BOOT_ARENA] __attribute__((aligned(16)));
+static size_t boot_used = 0;
+
+
+/*
+ * bootAlloc - the zeroed memory dlsym() may ask for before the real
+ * allocator is known; it is never freed
+ */
+static void* bootAlloc(size_t size)
+{
+	size = (size + 15) & ~(size_t)15;
+	if(size > BOOT_ARENA - boot_used)
+		return NULL;
+	boot_used += size;
+	return boot_arena + boot_used - size;
+}
+
+static int inBootArena(void* p)
+{
+	return (char*)p >= boot_arena && (char*)p < boot_arena + BOOT_ARENA;
+}
+
+
+static void flushLog(void)
+{
+	size_t done = 0;
+
+	while(done < log_len) {
+		ssize_t n = write(log_fd, log_buf + done, log_len - done);
+		if(n <= 0)
+			break;
+		done += n;
+	}
+	log_len = 0;
+}
+
+/*
+ * appendLine - append a line to the log, ticking the event clock for events
+ * (under the lock, so the order of the loads is the order of the lines);
+ * the caller holds log_lock
+ */
+static void appendLine(const char* line, int len, int event)
+{
+	if(log_fd < 0 || len <= 0)
+		return;
+
+	if(log_len + len > LOG_BUFFER)
+		flushLog();
+	memcpy(log_buf + log_len, line, len);
+	log_len += len;
+	if(event)
+		(void)event_marker;
+}
+
+static void logLine(const char* line, int len, int event)
+{
+	pthread_mutex_lock(&log_lock);
+	appendLine(line, len, event);
+	pthread_mutex_unlock(&log_lock);
+}
+
+
+static void init(void)
+{
+	if(state != 0)
+		return;
+	state = 1;
+
+	real_malloc = dlsym(RTLD_NEXT, "malloc");
+	real_calloc = dlsym(RTLD_NEXT, "calloc");
+	real_realloc = dlsym(RTLD_NEXT, "realloc");
+	real_free = dlsym(RTLD_NEXT, "free");
+	real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+	real_aligned_alloc = dlsym(RTLD_NEXT, "aligned_alloc");
+
+	const char* path = getenv("CSIM_MALLOC_LOG");
+	const char* d = getenv("CSIM_MALLOC_DEPTH");
+
+	if(d && atoi(d) >= 1)
+		depth = atoi(d) < MAX_DEPTH ? atoi(d) : MAX_DEPTH;
+	log_fd = open(path ? path : DEFAULT_LOG, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+	              0644);
+
+	char line[64];
+	int n = snprintf(line, sizeof(line), "%s %d %lx\n", ALLOC_LOG_MAGIC,
+	                 ALLOC_LOG_VERSION, (unsigned long)&event_marker);
+	logLine(line, n, 0);
+	state = 2;
+}
+
+__attribute__((constructor)) static void start(void)
+{
+	init();
+}
+
+__attribute__((destructor)) static void finish(void)
+{
+	pthread_mutex_lock(&log_lock);
+	if(log_fd >= 0)
+		flushLog();
+	pthread_mutex_unlock(&log_lock);
+}
+
+
+/*
+ * callSite - hash of the caller's call chain; the first time a site is
+ * seen, a line describing its frames as object+offset is logged
+ */
+static __attribute__((noinline)) uint64_t callSite(void)
+{
+	void* frames[MAX_DEPTH + RECORDER_FRAMES];
+	char where[768];
+	uint64_t site = 0xcbf29ce484222325ULL;
+	size_t len = 0;
+	int used = 0;
+	Dl_info self;
+
+	//the innermost frames are the recorder's own
+	int n = backtrace(frames, depth + RECORDER_FRAMES);
+	if(!dladdr((void*)callSite, &self))
+		self.dli_fbase = NULL;
+	where[0] = '\0';
+
+	for(int i = 0; i < n && used < depth; i++) {
+		Dl_info info;
+		const char* object = "?";
+		uintptr_t offset = (uintptr_t)frames[i];
+
+		if(dladdr(frames[i], &info) && info.dli_fname) {
+			if(info.dli_fbase == self.dli_fbase)
+				continue;
+			object = strrchr(info.dli_fname, '/') ? strrchr(info.dli_fname, '/') + 1
+			                                      : info.dli_fname;
+			offset -= (uintptr_t)info.dli_fbase;
+		}
+		for(const char* p = object; *p; p++)
+			site = (site ^ (unsigned char)*p) * 0x100000001b3ULL;
+		site = (site ^ offset) * 0x100000001b3ULL;
+
+		if(len < sizeof(where))
+			len += snprintf(where + len, sizeof(where) - len, "%s%s+0x%lx",
+			                used ? ";" : "", object, (unsigned long)offset);
+		used++;
+	}
+
+	//describe each site once (or more, if too many to remember)
+	pthread_mutex_lock(&log_lock);
+	uint64_t* slot = &sites_seen[site % SITE_SLOTS];
+	int seen = *slot == site;
+	*slot = site;
+	pthread_mutex_unlock(&log_lock);
+
+	if(!seen) {
+		char line[sizeof(where) + 32];
+		int k = snprintf(line, sizeof(line), "s %016llx %s\n",
+		                 (unsigned long long)site, where);
+		logLine(line, k, 0);
+	}
+	return site;
+}
+
+
+static void logAlloc(void* p, size_t size)
+{
+	char line[96];
+	int n = snprintf(line, sizeof(line), "m %lx %zx %016llx\n", (unsigned long)p,
+	                 size, (unsigned long long)callSite());
+	logLine(line, n, 1);
+}
+
+
+void* malloc(size_t size)
+{
+	if(state != 2) {
+		init();
+		if(state != 2)
+			return bootAlloc(size);
+	}
+	if(busy)
+		return real_malloc(size);
+
+	busy = 1;
+	void* p = real_malloc(size);
+	if(p)
+		logAlloc(p, size);
+	busy = 0;
+	return p;
+}
+
+
+void* calloc(size_t count, size_t size)
+{
+	if(state != 2) {
+		init();
+		if(state != 2)
+			return count && size > BOOT_ARENA / count ? NULL : bootAlloc(count * size);
+	}
+	if(busy)
+		return real_calloc(count, size);
+
+	busy = 1;
+	void* p = real_calloc(count, size);
+	if(p)
+		logAlloc(p, count * size);
+	busy = 0;
+	return p;
+}
+
+
+void* realloc(void* old, size_t size)
+{
+	if(state != 2)
+		init();
+
+	//memory from the boot arena can only be copied out of it
+	if(inBootArena(old)) {
+		void* p = malloc(size);
+		size_t left = boot_arena + BOOT_ARENA - (char*)old;
+		if(p)
+			memcpy(p, old, size < left ? size : left);
+		return p;
+	}
+	if(busy)
+		return real_realloc(old, size);
+
+	busy = 1;
+	if(!old) {
+		void* p = real_realloc(old, size);
+		if(p)
+			logAlloc(p, size);
+		busy = 0;
+		return p;
+	}
+
+	//old can be handed out again the moment it is released, and whoever
+	//gets it logs under log_lock, so the release is done and logged under it
+	uint64_t site = size ? callSite() : 0;
+	char line[128];
+	int n = 0;
+
+	pthread_mutex_lock(&log_lock);
+	void* p = real_realloc(old, size);
+	if(p)
+		n = snprintf(line, sizeof(line), "r %lx %lx %zx %016llx\n",
+		             (unsigned long)old, (unsigned long)p, size,
+		             (unsigned long long)site);
+	else if(size == 0)
+		n = snprintf(line, sizeof(line), "f %lx\n", (unsigned long)old);
+	appendLine(line, n, 1);
+	pthread_mutex_unlock(&log_lock);
+	busy = 0;
+	return p;
+}
+
+
+int posix_memalign(void** p, size_t align, size_t size)
+{
+	if(state != 2)
+		init();
+	if(busy)
+		return real_posix_memalign(p, align, size);
+
+	busy = 1;
+	int err = real_posix_memalign(p, align, size);
+	if(err == 0)
+		logAlloc(*p, size);
+	busy = 0;
+	return err;
+}
+
+
+void* aligned_alloc(size_t align, size_t size)
+{
+	if(state != 2)
+		init();
+	if(busy)
+		return real_aligned_alloc(align, size);
+
+	busy = 1;
+	void* p = real_aligned_alloc(align, size);
+	if(p)
+		logAlloc(p, size);
+	busy = 0;
+	return p;
+}
+
+
+void free(void* p)
+{
+	if(!p || inBootArena(p))
+		return;
+	if(state != 2)
+		init();
+	if(busy || state != 2) {
+		real_free(p);
+		return;
+	}
+
+	//logged first: once released, p may be allocated and logged again
+	busy = 1;
+	char line[32];
+	int n = snprintf(line, sizeof(line), "f %lx\n", (unsigned long)p);
+	logLine(line, n, 1);
+
+	real_free(p);
+	busy = 0;
+}
@@ -0,0 +1,268 @@
+/*
+ * csim-pad.c - Recommend padding before the regions of a trace (arrays,
+ *     stack, ...) that minimises its misses, without rebuilding and
+ *     retracing the program for every layout.
+ *
+ * Regions are given with -R or found by clustering the trace's addresses
+ * (see region.h).  Padding before a region moves it and every region
+ * after it, as inserting it into the program would, so regions never
+ * overlap.  The search tries every multiple of the step up to the largest
+ * padding (by default one line at a time through all sets, which is all
+ * that matters to the set index) before one region at a time, with the
+ * other paddings kept where the search left them; it goes over the
+ * regions again until no padding helps.  All offsets of one region are
+ * simulated at once, in lockstep lanes (see cachesim.h) spread over a
+ * pool of threads.
+ *
+ * Usage: csim-pad [-h] -s <num> -E <num> -b <num> -t <file> [-R <lo-hi> ...]
+ *                 [--gap <bytes>] [--step <bytes>] [--max-offset <bytes>] [-j <threads>]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "cachesim.h"
+#include "trace.h"
+#include "region.h"
+
+/* Most offsets tried for one region in one round */
+#define MAX_CANDIDATES 256
+/* Rounds over all regions before giving up on converging */
+#define MAX_ROUNDS 4
+/*
+ * padRegions - the shift of count regions (sorted by address) with
+ * padding[g] bytes inserted before region g
+ */
+static void padRegions(region_shift_t* shift, const region_t* regions,
+                       int count, const mem_addr_t* padding)
+{
+    mem_addr_t offset = 0;
+
+    shift->count = count;
+    shift->regions = regions;
+    for(int g = 0; g < count; g++)
+        shift->offsets[g] = offset += padding[g];
+}
+
+
+/*
+ * runRound - simulate the trace under count region shifts, on threads
+ */
+static void runRound(cache_lane_t* lanes, region_shift_t* shifts, int count,
+              const access_t* trace, size_t length, int s, int E, int b,
+              int threads)
+{
+    for(int l = 0; l < count; l++) {
+        initCache(&lanes[l].cache, s, E, b);
+        lanes[l].map = shiftRegions;
+        lanes[l].map_arg = &shifts[l];
+    }
+
+    simulateLanes(lanes, count, trace, length, threads);
+
+    for(int l = 0; l < count; l++)
+        freeCache(&lanes[l].cache);
+}
+
+
+/*
+ * printUsage - Print usage info
+ */
+void printUsage(char* argv[])
+{
+    printf("Usage: %s [-h] -s <num> -E <num> -b <num> -t <file> [-R <lo-hi> ...]\n"
+           "          [--gap <bytes>] [--step <bytes>] [--max-offset <bytes>] [-j <threads>]\n",
+           argv[0]);
+    printf("Options:\n");
+    printf("  -h         Print this help message.\n");
+    printf("  -s <num>   Number of set index bits.\n");
+    printf("  -E <num>   Number of lines per set.\n");
+    printf("  -b <num>   Number of block offset bits.\n");
+    printf("  -t <file>  Trace file.\n");
+    printf("  --format <fmt>  Trace format (default: detected).\n");
+    printf("  -R <lo-hi> A region (hex addresses, hi exclusive); repeat for\n"
+           "             more.  Without -R, regions are found in the trace.\n");
+    printf("  --gap <bytes>   Distance that separates found regions (default %d).\n",
+           REGION_GAP);
+    printf("  --step <bytes>  Granularity of the padding, a multiple of the block\n"
+           "                  size (default: block size).\n");
+    printf("  --max-offset <bytes>  Largest padding tried (default: the size of\n"
+           "                        one way, S * B).\n");
+    printf("  -j <num>   Number of threads (default: one per CPU).\n");
+    printf("\nExample:\n");
+    printf("  linux>  %s -s 5 -E 1 -b 5 -t traces/trans.trace\n", argv[0]);
+}
+
+int main(int argc, char* argv[])
+{
+    enum { OPT_FORMAT = 256, OPT_GAP, OPT_STEP, OPT_MAX_OFFSET };
+    static struct option long_options[] = {
+        {"format",     required_argument, NULL, OPT_FORMAT},
+        {"gap",        required_argument, NULL, OPT_GAP},
+        {"step",       required_argument, NULL, OPT_STEP},
+        {"max-offset", required_argument, NULL, OPT_MAX_OFFSET},
+        {NULL, 0, NULL, 0}
+    };
+    region_t regions[MAX_REGIONS];
+    int region_count = 0;
+    trace_format_t format = TRACE_AUTO;
+    char* trace_file = NULL;
+    mem_addr_t gap = REGION_GAP, step = 0, max_offset = 0;
+    int s = -1, E = -1, b = -1;
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int c;
+
+    while((c = getopt_long(argc, argv, "s:E:b:t:R:j:h", long_options, NULL)) != -1) {
+        switch(c) {
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 't':
+            trace_file = optarg;
+            break;
+        case 'R':
+            if(region_count == MAX_REGIONS ||
+               parseRegion(&regions[region_count], optarg) != 0) {
+                printf("%s: bad region %s\n", argv[0], optarg);
+                exit(1);
+            }
+            region_count++;
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case OPT_FORMAT:
+            format = parseTraceFormat(optarg);
+            if((int)format < 0) {
+                printf("%s: unknown trace format %s\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case OPT_GAP:
+            gap = strtoull(optarg, NULL, 0);
+            break;
+        case OPT_STEP:
+            step = strtoull(optarg, NULL, 0);
+            break;
+        case OPT_MAX_OFFSET:
+            max_offset = strtoull(optarg, NULL, 0);
+            break;
+        case 'h':
+            printUsage(argv);
+            exit(0);
+        default:
+            printUsage(argv);
+            exit(1);
+        }
+    }
+
+    if(s < 0 || E < 1 || b < 0 || !trace_file) {
+        printf("%s: Missing required command line argument\n", argv[0]);
+        printUsage(argv);
+        exit(1);
+    }
+    if(threads < 1)
+        threads = 1;
+    mem_addr_t B = 1ULL << b;
+    if(!step)
+        step = B;
+    if(step % B) {
+        printf("%s: --step must be a multiple of the block size (%llu)\n",
+               argv[0], B);
+        exit(1);
+    }
+    if(!max_offset)
+        max_offset = (1ULL << (s + b)) - step;
+
+    //candidate offsets 0, step, 2 step, ..., coarser (still whole blocks)
+    //if there'd be too many
+    int candidates = max_offset / step + 1;
+    if(candidates > MAX_CANDIDATES) {
+        step = (max_offset + MAX_CANDIDATES - 1) / (MAX_CANDIDATES - 1);
+        step = (step + B - 1) / B * B;
+        candidates = max_offset / step + 1;
+    }
+
+    size_t length;
+    access_t* trace = loadTrace(trace_file, format, &length);
+    if(!trace) {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], trace_file, strerror(errno));
+        exit(1);
+    }
+
+    region_count = traceRegions(regions, region_count, trace, length, gap);
+    if(region_count < 0) {
+        printf("%s: %s\n", argv[0],
+               errno == EINVAL ? "regions overlap" : strerror(errno));
+        exit(1);
+    }
+
+    region_shift_t traced, shifts[MAX_CANDIDATES];
+    mem_addr_t padding[MAX_REGIONS] = { 0 };
+    cache_lane_t* lanes = calloc(candidates, sizeof(cache_lane_t));
+
+    //the layout as traced
+    padRegions(&traced, regions, region_count, padding);
+    runRound(lanes, &traced, 1, trace, length, s, E, b, threads);
+    cache_t baseline = lanes[0].cache;
+    cache_t result = baseline;
+
+    //move one region at a time to its best offset until nothing improves
+    int rounds = 0, moved = 1;
+    while(moved && rounds++ < MAX_ROUNDS) {
+        moved = 0;
+        for(int g = 0; g < region_count; g++) {
+            mem_addr_t kept = padding[g];
+
+            for(int k = 0; k < candidates; k++) {
+                padding[g] = k * step;
+                padRegions(&shifts[k], regions, region_count, padding);
+            }
+            padding[g] = kept;
+            runRound(lanes, shifts, candidates, trace, length, s, E, b, threads);
+
+            //ties go to the padding the region already has
+            for(int k = 0; k < candidates; k++) {
+                cache_t* cache = &lanes[k].cache;
+                if(cache->miss_count < result.miss_count) {
+                    result = *cache;
+                    padding[g] = k * step;
+                    moved = 1;
+                }
+            }
+        }
+    }
+
+    region_shift_t best;
+    padRegions(&best, regions, region_count, padding);
+
+    printf("Searched paddings 0 to %llu in steps of %llu over %d regions (%d rounds)\n",
+           (mem_addr_t)(candidates - 1) * step, step, region_count, rounds);
+    printf("%-32s %10s %10s %10s\n", "region", "bytes", "padding", "moved");
+    for(int g = 0; g < region_count; g++) {
+        char range[40];
+
+        snprintf(range, sizeof(range), "%llx-%llx", regions[g].lo, regions[g].hi);
+        printf("%-32s %10llu %10llu %10llu\n", range, regions[g].hi - regions[g].lo,
+               padding[g], best.offsets[g]);
+    }
+    printf("\n%-10s %10s %10s %10s\n", "", "hits", "misses", "evictions");
+    printf("%-10s %10d %10d %10d\n", "as traced", baseline.hit_count,
+           baseline.miss_count, baseline.eviction_count);
+    printf("%-10s %10d %10d %10d\n", "padded", result.hit_count,
+           result.miss_count, result.eviction_count);
+
+    free(lanes);
+    free(trace);
+    return 0;
+}
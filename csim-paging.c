@@ -0,0 +1,196 @@
+/*
+ * csim-paging.c - Replay a trace once under several virtual to physical
+ *     page mappings (see paging.h), each on its own physically indexed
+ *     cache, and compare misses.
+ *
+ * The trace is decoded a batch at a time, and every batch is simulated on
+ * all mappings in lockstep (see simulateLockstep() in cachesim.h).  Each
+ * random mapping draws its frames from its own seed, so listing a policy
+ * twice shows how much its result depends on luck.
+ *
+ * Usage: csim-paging [-h] -s <num> -E <num> -b <num> -t <file>
+ *                    [-p <policy,...>] [--page-bits <num>]
+ *                    [--phys-bits <num>] [--index <fn>] [--seed <num>]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include "cachesim.h"
+#include "trace.h"
+#include "paging.h"
+
+/* Most mappings compared in one run */
+#define MAX_POLICIES 32
+
+/*
+ * printUsage - Print usage info
+ */
+void printUsage(char* argv[])
+{
+    printf("Usage: %s [-h] -s <num> -E <num> -b <num> -t <file>\n"
+           "          [-p <policy,...>] [--page-bits <num>] [--phys-bits <num>]\n"
+           "          [--index <fn>] [--seed <num>]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h         Print this help message.\n");
+    printf("  -s <num>   Number of set index bits.\n");
+    printf("  -E <num>   Number of lines per set.\n");
+    printf("  -b <num>   Number of block offset bits.\n");
+    printf("  -t <file>  Trace file.\n");
+    printf("  --format <fmt>  Trace format (default: detected).\n");
+    printf("  -p <list>  Mappings to compare: identity, random, color:<N>,\n"
+           "             huge[:<bits>] (default identity,random,color:<colors\n"
+           "             of the cache>,huge).\n");
+    printf("  --page-bits <num>  Page size, in bits (default %d).\n", PAGE_BITS);
+    printf("  --phys-bits <num>  Physical memory size, in bits (default %d).\n",
+           PHYS_BITS);
+    printf("  --index <fn>       Set index function of the caches (see csim -h).\n");
+    printf("  --seed <num>       Random seed (default 1).\n");
+    printf("\nExample:\n");
+    printf("  linux>  %s -s 12 -E 8 -b 6 -t traces/long.trace -p identity,random,random\n",
+           argv[0]);
+}
+
+int main(int argc, char* argv[])
+{
+    enum { OPT_FORMAT = 256, OPT_PAGE_BITS, OPT_PHYS_BITS, OPT_INDEX, OPT_SEED };
+    static struct option long_options[] = {
+        {"format",    required_argument, NULL, OPT_FORMAT},
+        {"page-bits", required_argument, NULL, OPT_PAGE_BITS},
+        {"phys-bits", required_argument, NULL, OPT_PHYS_BITS},
+        {"index",     required_argument, NULL, OPT_INDEX},
+        {"seed",      required_argument, NULL, OPT_SEED},
+        {NULL, 0, NULL, 0}
+    };
+    char default_policies[64];
+    char* policy_list = NULL;
+    trace_format_t format = TRACE_AUTO;
+    char* trace_file = NULL;
+    char* index_spec = NULL;
+    int s = -1, E = -1, b = -1;
+    int page_bits = PAGE_BITS, phys_bits = PHYS_BITS;
+    uint64_t seed = 1;
+    int c;
+
+    while((c = getopt_long(argc, argv, "s:E:b:t:p:h", long_options, NULL)) != -1) {
+        switch(c) {
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 't':
+            trace_file = optarg;
+            break;
+        case 'p':
+            policy_list = optarg;
+            break;
+        case OPT_FORMAT:
+            format = parseTraceFormat(optarg);
+            if((int)format < 0) {
+                printf("%s: unknown trace format %s\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case OPT_PAGE_BITS:
+            page_bits = atoi(optarg);
+            break;
+        case OPT_PHYS_BITS:
+            phys_bits = atoi(optarg);
+            break;
+        case OPT_INDEX:
+            index_spec = optarg;
+            break;
+        case OPT_SEED:
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'h':
+            printUsage(argv);
+            exit(0);
+        default:
+            printUsage(argv);
+            exit(1);
+        }
+    }
+
+    if(s < 0 || E < 1 || b < 0 || !trace_file) {
+        printf("%s: Missing required command line argument\n", argv[0]);
+        printUsage(argv);
+        exit(1);
+    }
+    if(page_bits < 1 || page_bits > 30) {
+        printf("%s: --page-bits must be between 1 and 30\n", argv[0]);
+        exit(1);
+    }
+
+    cache_index_t index;
+    if(index_spec && parseCacheIndex(&index, index_spec, s) != 0) {
+        printf("%s: bad set index function %s for -s %d\n", argv[0], index_spec, s);
+        exit(1);
+    }
+
+    //a page holds this many of the cache's sets; the rest of the set index
+    //is the page's color, the part the mapping decides
+    int color_bits = s + b > page_bits ? s + b - page_bits : 0;
+
+    if(!policy_list) {
+        snprintf(default_policies, sizeof(default_policies),
+                 "identity,random,color:%d,huge", 1 << color_bits);
+        policy_list = default_policies;
+    }
+
+    //one lane per mapping
+    page_map_t maps[MAX_POLICIES];
+    cache_lane_t lanes[MAX_POLICIES];
+    int count = 0;
+
+    for(char* tok = strtok(policy_list, ","); tok; tok = strtok(NULL, ",")) {
+        if(count == MAX_POLICIES ||
+           parsePagePolicy(&maps[count], tok, page_bits, phys_bits,
+                           seed + count) != 0) {
+            printf("%s: bad mapping %s\n", argv[0], tok);
+            exit(1);
+        }
+        initIndexedCache(&lanes[count].cache, s, E, b, index_spec ? &index : NULL);
+        lanes[count].map = translateAddress;
+        lanes[count].map_arg = &maps[count];
+        count++;
+    }
+
+    trace_reader_t reader;
+    access_t batch[TRACE_BATCH];
+    int n;
+
+    if(openTrace(&reader, trace_file, format, 0) != 0) {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], trace_file, strerror(errno));
+        exit(1);
+    }
+    while((n = readTrace(&reader, batch, TRACE_BATCH)) > 0)
+        simulateLockstep(lanes, count, batch, n);
+    closeTrace(&reader);
+
+    printf("Cache of %d page colors with %d byte pages\n", 1 << color_bits,
+           1 << page_bits);
+    printf("%-16s %10s %10s %10s %10s\n", "mapping", "pages", "hits", "misses",
+           "evictions");
+    for(int l = 0; l < count; l++) {
+        cache_t* cache = &lanes[l].cache;
+
+        if(maps[l].policy == PAGE_IDENTITY)
+            printf("%-16s %10s ", maps[l].name, "-");
+        else
+            printf("%-16s %10zu ", maps[l].name, maps[l].pages);
+        printf("%10d %10d %10d\n", cache->hit_count, cache->miss_count,
+               cache->eviction_count);
+        freeCache(cache);
+        freePageMap(&maps[l]);
+    }
+    return 0;
+}
@@ -5,15 +5,52 @@
  *     evictions.  The replacement policy is LRU.
  *
  * Implementation and assumptions:
- *  1. Each load/store can cause at most one cache miss. (I examined the trace,
- *  the largest request I saw was for 8 bytes).
+ *  1. A load/store touches every block its bytes fall in: one whose first
+ *  and last bytes lie in different blocks (a mask test on the two addresses)
+ *  is split into one access per block, and can miss in each.  These records
+ *  are reported as straddles, unless there are none.
  *  2. Instruction loads (I) are ignored, since we are interested in evaluating
  *  trans.c in terms of its data cache performance.
  *  3. data modify (M) is treated as a load followed by a store to the same
  *  address. Hence, an M operation can result in two cache hits, or a miss and a
  *  hit plus an possible eviction.
+ *  4. Instead of a trace file, accesses can be streamed from a running
+ *  program through the shared-memory ring described in csim_ring.h (-r).
+ *  5. With -d, csim runs as a daemon answering queries over a Unix domain
+ *  socket (see csim_proto.h) and keeps decoded traces resident.
+ *  6. Besides Valgrind lackey traces, Pin pinatrace, DynamoRIO memtrace and
+ *  ChampSim traces can be replayed (see trace.h); all of them are decoded
+ *  into batches of accesses first.
+ *  7. With --checkpoint, the cache, counters and trace offset are saved
+ *  periodically, and a later run resumes from them, replaying only the
+ *  records appended to the trace since.
+ *  8. Addresses are classified into regions (stack, heap, globals, mmap, or
+ *  ranges given with --region, see region.h).  --by-region splits the
+ *  statistics by region, and --only-region drops the accesses to every other
+ *  region while the trace is decoded, so they never reach the cache.
+ *  9. With --symbols, accesses are also charged to the global or static
+ *  variable holding their address, from the traced program's ELF file or nm
+ *  output (see symbols.h).
+ *  10. With --malloc-log, heap accesses are charged to the call site that
+ *  allocated their block, from the log of the csim-malloc recorder preloaded
+ *  into the traced program (see alloclog.h).  The recorder's marker loads
+ *  keep the log in step with the trace and are not simulated.
+ *  11. Sets are picked by address bits s+b-1..b unless --index chooses a
+ *  hashed or modulo index function (see cachesim.h); lines are tagged with
+ *  their whole block address either way.
+ *  12. --org simulates a skewed-associative cache or a zcache instead, with
+ *  lru or rrip victim selection (see cachesim.h).  Both keep the capacity
+ *  of the -s/-E geometry: 2^s rows in each of E ways.
+ *  13. With --sectors <n>, each line is a sector of n sub-blocks with their
+ *  own valid and dirty bits, filled one at a time; misses of a sub-block
+ *  whose sector was present are also reported apart, with the bytes fetched
+ *  and written back.  Stores allocate, and M stores after loading.
+ *  14. --block-sizes simulates a cache of each listed block size at once,
+ *  all of the capacity given by -s, -E and -b (-s is adjusted for each), fed
+ *  the same decoded batches in lockstep.
  *
  */
+#define _POSIX_C_SOURCE 200809L
 #include <getopt.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -24,12 +61,38 @@
 #include <string.h>
 #include <errno.h>
 #include<stdbool.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <inttypes.h>
 
 #include "cachelab.h"
+#include "cachesim.h"
+#include "csim_ring.h"
+#include "csim_proto.h"
+#include "trace.h"
+#include "region.h"
+#include "symbols.h"
+#include "alloclog.h"
 
 // #define DEBUG_ON 
 #define ADDRESS_LENGTH 64
 
+/* Number of records consumed from a ring before handing slots back */
+#define RING_BATCH 4096
+/* Most rings (-r) that can feed one cache */
+#define MAX_RINGS 64
+/* Default number of trace records between two checkpoints */
+#define CHECKPOINT_EVERY 1000000
+/* Most block sizes simulated at once (--block-sizes) */
+#define MAX_BLOCK_SIZES 16
+/* Starting value for hashBytes() */
+#define HASH_SEED 0xcbf29ce484222325ULL
+
 /****************************************************************************/
 
 /* Globals set by command line args */
@@ -38,270 +101,1301 @@ int s = 0; /* set index bits */
 int b = 0; /* block offset bits */
 int E = 0; /* associativity */
 char* trace_file = NULL;
+trace_format_t trace_format = TRACE_AUTO; /* --format, detected by default */
+char* ring_names[MAX_RINGS]; /* shared-memory rings to consume instead of a trace */
+int ring_count = 0;
+long long warmup = 0; /* leading trace records left out of the statistics */
+char* save_state = NULL; /* snapshot to write once the trace is replayed */
+char* load_state = NULL; /* snapshot to start from instead of a cold cache */
+char* checkpoint_file = NULL; /* sidecar to resume from and checkpoint to */
+long long checkpoint_every = CHECKPOINT_EVERY; /* records between checkpoints */
+int by_region = 0; /* --by-region: statistics per address region */
+char* only_regions = NULL; /* --only-region: comma separated names to keep */
+char* symbol_file = NULL; /* --symbols: ELF file or nm output of the program */
+mem_addr_t symbol_base = 0; /* --symbol-base: where the program was loaded */
+char* malloc_log = NULL; /* --malloc-log: allocations logged by csim-malloc */
+char* index_spec = NULL; /* --index: set index function, address bits if NULL */
+char* org_spec = NULL; /* --org: cache organisation, set-associative if NULL */
+int sectors = 0; /* --sectors: sub-blocks per line, 0 for a plain cache */
+char* block_sizes = NULL; /* --block-sizes: comma separated b to compare */
 
-/* Derived from command line args */
-int S; // number of sets S = 2^s
-int B; // block size (bytes) B = 2^b
-
-/* Counters used to record cache statistics */
-int miss_count = 0;
-int hit_count = 0;
-int eviction_count = 0;
 /*****************************************************************************/
 
 
-/* Type: Memory address 
-  */
-typedef unsigned long long int mem_addr_t;
+/* The cache we are simulating */
+cache_t cache;  
+
+/* How far into the trace the cache is, when checkpointing */
+cache_resume_t trace_pos;
+
+/* Statistics charged to one region or symbol */
+typedef struct access_stats {
+    int hits, misses, evictions;
+} access_stats_t;
 
-/* Type: Cache line
- * 
- * A structure for representing a line in a cache, contains a counter for 
- * tracking which line is the least recently used. 
+/* Address regions, and the statistics of each when --by-region is given;
+ * the slot after the last region counts addresses outside all of them */
+region_table_t regions;
+access_stats_t region_stats[MAX_REGIONS + 1];
+
+/* Symbols, and the statistics of each (plus one slot for addresses outside
+ * every symbol) when --symbols is given */
+symbol_table_t symbols;
+access_stats_t* symbol_stats = NULL;
+
+/* Heap allocations, and the statistics of each allocation site (plus one
+ * slot for accesses outside live allocations) when --malloc-log is given */
+alloc_log_t allocs;
+access_stats_t* site_stats = NULL;
+
+/* Whether --only-region keeps each region: 1 or 0, -1 until first seen */
+signed char region_kept[MAX_REGIONS];
+
+
+/*
+ * regionIndex - slot of addr in the region statistics
  */
-typedef struct cache_line {
-   	 char valid;
-   	 mem_addr_t tag;
-	 int counter;
-} cache_line_t;
+int regionIndex(mem_addr_t addr)
+{
+    int r = classifyAddress(&regions, addr);
+    return r < 0 ? MAX_REGIONS : r;
+}
 
-typedef cache_line_t* cache_set_t;
-typedef cache_set_t* cache_t;
 
+/*
+ * keepRegion - trace filter for --only-region: is addr in a named region?
+ * A region is looked up in the list once, the first time it is seen.
+ */
+int keepRegion(void* arg, mem_addr_t addr)
+{
+    int r = classifyAddress(&regions, addr);
+
+    (void)arg;
+    if(site_stats && addr == allocs.marker)
+        return 1;
+    if(r < 0)
+        return 0;
+
+    if(region_kept[r] < 0) {
+        const char* name = regions.names[r];
+        size_t len = strlen(name);
+        const char* p = only_regions;
+
+        region_kept[r] = 0;
+        while(p) {
+            if(strncmp(p, name, len) == 0 && (p[len] == ',' || p[len] == '\0'))
+                region_kept[r] = 1;
+            p = strchr(p, ',');
+            if(p)
+                p++;
+        }
+    }
+    return region_kept[r];
+}
 
-/* The cache we are simulating */
-cache_t cache;  
 
 /*
- * Allocate data structures to hold info regrading the sets and cache lines
- * 
- * Initialize valid and tag field with 0s.
- *
+ * printRegions - the statistics of every region with any accesses
  */
-void initCache()
+void printRegions(void)
 {
-	//calculate S using the commandline arg
-	S = pow(2, s);
-	
-	//allocate space for the number of sets
-	cache = malloc(S * sizeof(cache_set_t));
+    printf("%-16s %-33s %10s %10s %10s\n", "region", "range", "hits",
+           "misses", "evictions");
+    for(int r = 0; r <= regions.count; r++) {
+        int i = r == regions.count ? MAX_REGIONS : r;
+        char range[40];
+
+        access_stats_t* st = &region_stats[i];
+
+        if(st->hits + st->misses == 0)
+            continue;
+        if(i == MAX_REGIONS)
+            snprintf(range, sizeof(range), "-");
+        else
+            snprintf(range, sizeof(range), "%llx-%llx", regions.ranges[i].lo,
+                     regions.ranges[i].hi);
+        printf("%-16s %-33s %10d %10d %10d\n",
+               i == MAX_REGIONS ? "(other)" : regions.names[i], range,
+               st->hits, st->misses, st->evictions);
+    }
+}
+
 
-	//iterate through sets, allocate space for lines
-	for(int i = 0; i < S; i++) {
+/* The statistics rankByMisses() is sorting */
+static const access_stats_t* ranked;
 
-		cache[i] = malloc(E * sizeof(cache_line_t));
-		
-		//set the appropriate field values
-		for(int j = 0; j < E; j++) {
-		
-			cache[i][j].valid = '0';
-			cache[i][j].tag = 0;
-			cache[i][j].counter = 0;
-		}
-	} 	
+static int byMisses(const void* x, const void* y)
+{
+    const access_stats_t* a = &ranked[*(const int*)x];
+    const access_stats_t* b = &ranked[*(const int*)y];
+
+    if(a->misses != b->misses)
+        return a->misses > b->misses ? -1 : 1;
+    return (a->hits < b->hits) - (a->hits > b->hits);
 }
 
+/*
+ * rankByMisses - the indexes of the count stats with any accesses, most
+ * misses first, in order; returns how many
+ */
+int rankByMisses(const access_stats_t* stats, int count, int* order)
+{
+    int n = 0;
+
+    for(int i = 0; i < count; i++) {
+        if(stats[i].hits + stats[i].misses)
+            order[n++] = i;
+    }
+    ranked = stats;
+    qsort(order, n, sizeof(int), byMisses);
+    return n;
+}
 
 /*
- * freeCache - free each piece of memory  allocated using malloc 
- * inside initCache() function
+ * printSymbols - the statistics of every symbol with any accesses, most
+ * misses first
  */
-void freeCache()
+void printSymbols(void)
 {
+    int* order = malloc((symbols.count + 1) * sizeof(int));
+    int n = rankByMisses(symbol_stats, symbols.count + 1, order);
+
+    printf("%-32s %-33s %10s %10s %10s\n", "symbol", "range", "hits",
+           "misses", "evictions");
+    for(int k = 0; k < n; k++) {
+        int i = order[k];
+        access_stats_t* st = &symbol_stats[i];
+        char range[40];
+
+        if(i == symbols.count)
+            snprintf(range, sizeof(range), "-");
+        else
+            snprintf(range, sizeof(range), "%llx-%llx", symbols.syms[i].lo,
+                     symbols.syms[i].hi);
+        printf("%-32s %-33s %10d %10d %10d\n",
+               i == symbols.count ? "(none)" : symbols.syms[i].name, range,
+               st->hits, st->misses, st->evictions);
+    }
+    free(order);
+}
 
-	//recalculate in case initCache() not called
-	S = pow(2, s);
 
-	//iterate through the sets and free
-	for(int i = 0; i < S; i++) {
+/*
+ * printSites - the statistics of every allocation site with any accesses,
+ * most misses first
+ */
+void printSites(void)
+{
+    int* order = malloc((allocs.site_count + 1) * sizeof(int));
+    int n = rankByMisses(site_stats, allocs.site_count + 1, order);
+
+    printf("%-16s %8s %12s %10s %10s %10s  %s\n", "site", "allocs", "bytes",
+           "hits", "misses", "evictions", "call chain");
+    for(int k = 0; k < n; k++) {
+        int i = order[k];
+        access_stats_t* st = &site_stats[i];
+
+        if(i == allocs.site_count) {
+            printf("%-16s %8s %12s %10d %10d %10d\n", "(not heap)", "-", "-",
+                   st->hits, st->misses, st->evictions);
+            continue;
+        }
+        alloc_site_t* site = &allocs.sites[i];
+        printf("%016llx %8llu %12llu %10d %10d %10d  %s\n",
+               (unsigned long long)site->id, (unsigned long long)site->count,
+               (unsigned long long)site->bytes, st->hits, st->misses,
+               st->evictions, site->where);
+    }
+    free(order);
+
+    if(allocs.next < allocs.event_count)
+        fprintf(stderr, "%s: only %zu of %zu allocation events were found in the "
+                "trace\n", malloc_log, allocs.next, allocs.event_count);
+}
 
-		free(cache[i]);
-	}
-	
-	//free the cache val itself
-	free(cache);
 
+/*
+ * chargeAccess - add what one access did to the counters to st
+ */
+static inline void chargeAccess(access_stats_t* st, cache_t* cache,
+                                const access_stats_t* before)
+{
+    st->hits += cache->hit_count - before->hits;
+    st->misses += cache->miss_count - before->misses;
+    st->evictions += cache->eviction_count - before->evictions;
 }
 
+/*
+ * endWarmup - start counting afresh: clear the cache's statistics and
+ * those charged to regions, symbols and allocation sites
+ */
+void endWarmup(cache_t* cache)
+{
+    clearStats(cache);
+    memset(region_stats, 0, sizeof(region_stats));
+    if(symbol_stats)
+        memset(symbol_stats, 0, (symbols.count + 1) * sizeof(access_stats_t));
+    if(site_stats)
+        memset(site_stats, 0, (allocs.site_count + 1) * sizeof(access_stats_t));
+}
 
-/* 
- * accessData - Access data at memory address addr.
- *   If it is already in cache, increase hit_count
- *   If it is not in cache, bring it in cache, increase miss count.
- *   Increase eviction_count if a line is evicted.
- *   Manipulate data structures allocated in initCache() here
- */
-void accessData(mem_addr_t addr)
-{
-
-	//mask address to isolate the set and tag
-	mem_addr_t mask = pow(2, s + b);
-	mask --;
-
-	//set proper bits
-	mask -= (pow(2, b) - 1);	
-	
-	//isolate set number
-	mem_addr_t targSet = addr & mask;
-	targSet = targSet >> b;
-	
-	//extract tag
-	mem_addr_t targTag = addr >> (s + b);
-	
-	//int boolean variable if the cache will be a hit
-	int found = 0;
-
-	//values set to arbitrary numbers for finding desired lines
-	int min = 5000;
-	int max = 0;
-	int minIndex = -1;
-	
-	//iterate  through all sets and find min and max counters
-	for(int j = 0; j < E; j++) {
-
-		//if it's the new min
-		if(cache[targSet][j].counter < min) {
-
-			min = cache[targSet][j].counter;
-			minIndex = j;
-
-		}
-
-		//if it's the new max
-		if(cache[targSet][j].counter > max) {
-
-			max = cache[targSet][j].counter;
-		}
-	}
-
-	//iterate through and find the line if possible
-	for(int i = 0; i < E; i++) {
-
-		//if it's valid and the correct tag
-		if(cache[targSet][i].valid == '1' && cache[targSet][i].tag == targTag) {
-
-			//it's found, increment
-			found = 1;
-			hit_count++;
-
-			//set counter val
-			cache[targSet][i].counter =  max + 1;
-			break;
-		}
-	}
-	
-
-	//if no hits
-	if(found == 0) {
-
-		//then it's a miss
-		miss_count++;
-
-		//var for knowing if it's an eviction or not
-		int foundEmpty = 0;
-
-		//iterate through to find any that are empty
-		for(int k = 0; k < E; k++) {
-
-			//if an empty one is found
-			if(cache[targSet][k].valid == '0') {
-
-				//set that to the target
-				cache[targSet][k].valid = '1';
-				cache[targSet][k].tag = targTag;
-				cache[targSet][k].counter = max + 1;
-				
-				//we know one is found
-				foundEmpty = 1;
-		
-				break;
-				
-			}
-		}
-
-		//if no empty ones have been found
-		if(foundEmpty == 0) {
-
-			//we have to evict one
-			eviction_count++;
-		
-			//evict the minimum counter value line
-			cache[targSet][minIndex].tag = targTag;
-			cache[targSet][minIndex].counter = max + 1;
-		}		
-	}	
+/*
+ * replayAccess - replay a single trace record, printing it if verbose
+ * The first --warmup records only warm the cache up: the statistics are
+ * cleared once they have been replayed.
+ */
+void replayAccess(cache_t* cache, char op, mem_addr_t addr, unsigned int len)
+{
+    //the allocation recorder's clock, not an access of the program
+    if(site_stats && addr == allocs.marker) {
+        tickAllocations(&allocs);
+        return;
+    }
+
+    if(verbosity)
+        printf("%c %llx,%u ", op, addr, len);
+
+    if(by_region || symbol_stats || site_stats) {
+        access_stats_t before = { cache->hit_count, cache->miss_count,
+                                  cache->eviction_count };
+
+        simulateSpan(cache, op, addr, len);
+        if(by_region)
+            chargeAccess(&region_stats[regionIndex(addr)], cache, &before);
+        if(symbol_stats) {
+            int sym = findSymbol(&symbols, addr);
+            chargeAccess(&symbol_stats[sym < 0 ? symbols.count : sym], cache,
+                         &before);
+        }
+        if(site_stats) {
+            int site = findAllocation(&allocs, addr);
+            chargeAccess(&site_stats[site < 0 ? allocs.site_count : site], cache,
+                         &before);
+        }
+    } else {
+        simulateSpan(cache, op, addr, len);
+    }
+
+    //warm-up over, only count what follows
+    if(warmup > 0 && --warmup == 0)
+        endWarmup(cache);
+
+    if (verbosity)
+        printf("\n");
+}
+
+
+/*
+ * hashBytes - FNV-1a hash of len bytes, continuing from h (start with
+ * HASH_SEED); used to recognize trace contents
+ */
+uint64_t hashBytes(const void* data, size_t len, uint64_t h)
+{
+    const unsigned char* p = data;
+
+    for(size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+
+/*
+ * traceCheck - hash of the len bytes of a trace that end at offset
+ * A checkpoint remembers this for its last record, so a resumed run can
+ * tell an appended trace (check unchanged) from a rewritten one.
+ */
+uint64_t traceCheck(int fd, uint64_t offset, uint32_t len)
+{
+    char buf[1000];
+
+    if(len > sizeof(buf) || len > offset ||
+       pread(fd, buf, len, offset - len) != (ssize_t)len)
+        return 0;
+    return hashBytes(buf, len, HASH_SEED);
+}
+
+
+/*
+ * writeCheckpoint - save the cache and how far into the trace it got
+ * A failed checkpoint only costs a longer replay next time, so it is
+ * reported but not fatal.
+ */
+void writeCheckpoint(cache_t* cache, cache_resume_t* pos, int fd)
+{
+    pos->trace_check = traceCheck(fd, pos->trace_offset, pos->trace_check_len);
+    pos->warmup_left = warmup;
+
+    if(saveCache(cache, checkpoint_file, pos) != 0)
+        fprintf(stderr, "%s: %s\n", checkpoint_file, strerror(errno));
+}
+
+
+/*
+ * replayBatch - replay a batch of decoded accesses, in order
+ */
+void replayBatch(cache_t* cache, access_t* batch, int count)
+{
+    for(int i = 0; i < count; i++)
+        replayAccess(cache, batch[i].op, batch[i].addr, batch[i].len);
 }
 
 
 /* 
  * replayTrace - replays the given trace file against the cache 
- * reads the input trace file line by line
- * extracts the type of each memory access : L/S/M
- * Translates one "L" as a load i.e. 1 memory access
- * Translates one "S" as a store i.e. 1 memory access
- * Translates one "M" as a load followed by a store i.e. 2 memory accesses 
+ * decodes the trace (in any format trace.c understands) a batch of
+ * accesses at a time and hands each batch to replayBatch()
+ * With a trace position (--checkpoint), replay starts at pos->trace_offset,
+ * the position is kept up to date and a checkpoint is written about every
+ * checkpoint_every accesses and at the end.  A last line without its
+ * newline is still being appended by the tracer, so it is left for the
+ * next run.
  */
-void replayTrace(char* trace_fn)
+void replayTrace(cache_t* cache, char* trace_fn, cache_resume_t* pos)
 {
+    trace_reader_t reader;
+    access_t batch[TRACE_BATCH];
+    long long since = 0;
+    int n;
+
+    if(openTrace(&reader, trace_fn, trace_format, pos != NULL) != 0 ||
+       (pos && seekTrace(&reader, pos->trace_offset) != 0)){
+        fprintf(stderr, "%s: %s\n", trace_fn,
+                errno == EINVAL ? "unknown trace format" : strerror(errno));
+        exit(1);
+    }
+    if(only_regions)
+        filterTrace(&reader, keepRegion, NULL);
 
-	//read trace file, make successive calls
-    char buf[1000];
-    mem_addr_t addr=0;
-    unsigned int len=0;
-    FILE* trace_fp = fopen(trace_fn, "r");
+    while((n = readTrace(&reader, batch, TRACE_BATCH)) > 0) {
+        replayBatch(cache, batch, n);
+
+        if(pos) {
+            pos->trace_offset = reader.offset;
+            pos->trace_check_len = reader.last_len;
+            pos->trace_records += n;
+
+            if((since += n) >= checkpoint_every) {
+                writeCheckpoint(cache, pos, fileno(reader.fp));
+                since = 0;
+            }
+        }
+    }
+
+    if(pos)
+        writeCheckpoint(cache, pos, fileno(reader.fp));
+
+    closeTrace(&reader);
+}
+
+
+/*
+ * initRunCache - a cold cache of the given geometry, with the index
+ * function, organisation and sectors asked for; NULL, or the option that
+ * doesn't fit the geometry
+ */
+const char* initRunCache(cache_t* cache, int s, int E, int b)
+{
+    cache_index_t index;
+    cache_org_t org;
+
+    if(index_spec && parseCacheIndex(&index, index_spec, s) != 0)
+        return "--index";
+    if(org_spec && parseCacheOrg(&org, org_spec, s, E) != 0)
+        return "--org";
+    if(sectors && sectors > 1 << b)
+        return "--sectors";
+
+    if(sectors)
+        initSectorCache(cache, s, E, b, __builtin_ctz(sectors),
+                        index_spec ? &index : NULL);
+    else if(org_spec && org.kind != ORG_SET)
+        initSkewedCache(cache, s, E, b, &org);
+    else
+        initIndexedCache(cache, s, E, b, index_spec ? &index : NULL);
+    return NULL;
+}
+
+
+/*
+ * replayBlockSizes - replay the trace once on a cache of each block size
+ * in block_sizes, all as large as the -s/-E/-b one, and print a table
+ * The trace is decoded a batch at a time and each batch is run through
+ * every cache in lockstep (see simulateLockstep()).
+ */
+void replayBlockSizes(char* trace_fn)
+{
+    cache_lane_t lanes[MAX_BLOCK_SIZES];
+    int count = 0;
+
+    for(char* p = block_sizes; *p; ) {
+        char* next;
+        long bb = strtol(p, &next, 10);
+
+        //the same capacity in blocks of 2^bb bytes
+        if(next == p || (*next != ',' && *next != '\0') ||
+           count == MAX_BLOCK_SIZES || bb < 0 || bb > 30 || s + b - bb < 0 ||
+           s + b - bb > 30) {
+            fprintf(stderr, "--block-sizes: bad block size %.*s\n",
+                    (int)strcspn(p, ","), p);
+            exit(1);
+        }
+        const char* unfit = initRunCache(&lanes[count].cache, s + b - bb, E, bb);
+        if(unfit) {
+            fprintf(stderr, "--block-sizes: %s doesn't fit %ld sets of "
+                    "%ld byte blocks\n", unfit, 1L << (s + b - bb), 1L << bb);
+            exit(1);
+        }
+        lanes[count].map = NULL;
+        lanes[count].map_arg = NULL;
+        count++;
+        p = *next ? next + 1 : next;
+    }
 
-    if(!trace_fp){
-        fprintf(stderr, "%s: %s\n", trace_fn, strerror(errno));
+    trace_reader_t reader;
+    access_t batch[TRACE_BATCH];
+    int n;
+
+    if(openTrace(&reader, trace_fn, trace_format, 0) != 0) {
+        fprintf(stderr, "%s: %s\n", trace_fn,
+                errno == EINVAL ? "unknown trace format" : strerror(errno));
         exit(1);
     }
+    if(only_regions)
+        filterTrace(&reader, keepRegion, NULL);
+
+    while((n = readTrace(&reader, batch, TRACE_BATCH)) > 0) {
+        int start = 0;
+
+        //the warm-up may end within the batch
+        if(warmup > 0) {
+            start = warmup < n ? warmup : n;
+            simulateLockstep(lanes, count, batch, start);
+            if((warmup -= start) == 0)
+                for(int l = 0; l < count; l++)
+                    clearStats(&lanes[l].cache);
+        }
+        simulateLockstep(lanes, count, batch + start, n - start);
+    }
+    closeTrace(&reader);
+
+    //a trace shorter than the warm-up only warmed the caches up
+    if(warmup > 0)
+        for(int l = 0; l < count; l++)
+            clearStats(&lanes[l].cache);
+
+    printf("%6s %8s %10s %10s %10s %12s %10s\n", "block", "sets", "hits",
+           "misses", "evictions", "fill-bytes", "straddles");
+    for(int l = 0; l < count; l++) {
+        cache_t* c = &lanes[l].cache;
+
+        printf("%6d %8d %10d %10d %10d %12lld %10d\n", c->B, c->S, c->hit_count,
+               c->miss_count, c->eviction_count,
+               sectors ? c->fill_bytes : (long long)c->miss_count * c->B,
+               c->straddle_count);
+        freeCache(c);
+    }
+}
 
-    while( fgets(buf, 1000, trace_fp) != NULL) {
-        if(buf[1]=='S' || buf[1]=='L' || buf[1]=='M') {
-            sscanf(buf+3, "%llx,%u", &addr, &len);
-      
-            if(verbosity)
-                printf("%c %llx,%u ", buf[1], addr, len);
 
-   
+/*
+ * resumeTrace - pick up a previous run from its checkpoint
+ * Returns 1 and fills in cache and pos if checkpoint_file holds a cache of
+ * the requested geometry whose trace position still matches trace_fn.
+ * Otherwise (no checkpoint, another geometry, a truncated or rewritten
+ * trace) returns 0 and the trace is replayed from the start.
+ */
+int resumeTrace(cache_t* cache, char* trace_fn, cache_resume_t* pos)
+{
+    cache_t saved;
+    struct stat st;
+    const char* why = NULL;
+
+    if(loadCache(&saved, checkpoint_file, pos) != 0) {
+        if(errno != ENOENT)
+            fprintf(stderr, "%s: %s, starting over\n", checkpoint_file,
+                    errno == EINVAL ? "not a csim checkpoint" : strerror(errno));
+        return 0;
+    }
 
-		//if it's a load, load
-		if(buf[1] == 'L') {
+    int fd = open(trace_fn, O_RDONLY);
+    if(saved.s != s || saved.E != E || saved.b != b)
+        why = "taken with another cache geometry";
+    else if(fd < 0 || fstat(fd, &st) != 0 ||
+            (uint64_t)st.st_size < pos->trace_offset ||
+            traceCheck(fd, pos->trace_offset, pos->trace_check_len) !=
+                pos->trace_check)
+        why = "trace has been rewritten";
+    if(fd >= 0)
+        close(fd);
+
+    if(why) {
+        fprintf(stderr, "%s: %s, starting over\n", checkpoint_file, why);
+        freeCache(&saved);
+        return 0;
+    }
 
-			accessData(addr);
-			
-		}
+    if(verbosity)
+        printf("resuming after %lld records (byte %llu)\n",
+               (long long)pos->trace_records,
+               (unsigned long long)pos->trace_offset);
 
-		//if it's a store, store
-		else if(buf[1] == 'S') {
+    *cache = saved;
+    warmup = pos->warmup_left;
+    return 1;
+}
 
-			accessData(addr);
-			
-		}
 
-		//otherwise, do data move and access
-		else if(buf[1] == 'M') {
+/*
+ * openRing - map the shared-memory ring called name (see csim_ring.h)
+ * name is either a shm_open() name such as "/myapp", or "fd:N" for a
+ * memfd/shm descriptor inherited from the producer.
+ */
+csim_ring_t* openRing(char* name, size_t* size)
+{
+    int fd;
+    struct stat st;
 
-			accessData(addr);
-			accessData(addr);
+    if(strncmp(name, "fd:", 3) == 0)
+        fd = atoi(name + 3);
+    else
+        fd = shm_open(name, O_RDWR, 0);
 
-		}
+    if(fd < 0 || fstat(fd, &st) != 0){
+        fprintf(stderr, "%s: %s\n", name, strerror(errno));
+        exit(1);
+    }
 
+    csim_ring_t* ring = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd, 0);
+    close(fd);
 
+    if(ring == MAP_FAILED){
+        fprintf(stderr, "%s: %s\n", name, strerror(errno));
+        exit(1);
+    }
 
-            if (verbosity)
-                printf("\n");
+    //make sure this really is a ring, and that it fits in the mapping
+    if((size_t)st.st_size < sizeof(csim_ring_t) ||
+       __atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) != CSIM_RING_MAGIC ||
+       ring->version != CSIM_RING_VERSION ||
+       ring->capacity == 0 || (ring->capacity & (ring->capacity - 1)) ||
+       csim_ring_size(ring->capacity) > (size_t)st.st_size) {
+        fprintf(stderr, "%s: not a csim ring\n", name);
+        exit(1);
+    }
+
+    *size = st.st_size;
+    return ring;
+}
+
+
+/*
+ * drainRing - hand every record of a ring to consume() until the producer
+ * closes it.
+ * Records are consumed in place, a batch at a time, and the slots are only
+ * returned to the producer once the whole batch has been simulated.
+ */
+void drainRing(csim_ring_t* ring,
+               void (*consume)(void* arg, csim_ring_rec_t* rec), void* arg)
+{
+    uint64_t mask = ring->capacity - 1;
+    uint64_t tail = ring->tail;
+    int idle = 0;
+
+    while(1) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        //nothing new, either we are done or the producer is still working
+        if(head == tail) {
+            if(__atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE) &&
+               __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail)
+                break;
+
+            //spin briefly, then back off so an idle producer costs nothing
+            if(++idle < 64) {
+                sched_yield();
+            } else {
+                struct timespec pause = {0, 100000};
+                nanosleep(&pause, NULL);
+            }
+            continue;
         }
+        idle = 0;
+
+        if(head - tail > RING_BATCH)
+            head = tail + RING_BATCH;
+
+        for(; tail != head; tail++)
+            consume(arg, &ring->recs[tail & mask]);
+
+        //hand the batch back to the producer
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
     }
+}
+
 
-    fclose(trace_fp);
+void replayRingRecord(void* arg, csim_ring_rec_t* rec)
+{
+    if(!only_regions || keepRegion(NULL, rec->addr))
+        replayAccess((cache_t*)arg, rec->op, rec->addr, rec->len);
 }
 
+/*
+ * replayRing - replays accesses streamed through a shared-memory ring
+ * until the producer closes it.
+ */
+void replayRing(cache_t* cache, char* name)
+{
+    size_t size;
+    csim_ring_t* ring = openRing(name, &size);
+
+    drainRing(ring, replayRingRecord, cache);
+    munmap(ring, size);
+}
+
+
+/* One ring consumed by its own thread into a shared cache */
+typedef struct ring_job {
+    shared_cache_t* shared;
+    cache_thread_t* thread;
+    char* name;
+} ring_job_t;
+
+void sharedRingRecord(void* arg, csim_ring_rec_t* rec)
+{
+    ring_job_t* job = arg;
+
+    sharedAccessSpan(job->shared, job->thread, rec->op, rec->addr, rec->len);
+}
+
+void* ringWorker(void* arg)
+{
+    ring_job_t* job = arg;
+    size_t size;
+    csim_ring_t* ring = openRing(job->name, &size);
+
+    job->thread = attachSharedCache(job->shared);
+    drainRing(ring, sharedRingRecord, job);
+    munmap(ring, size);
+    return NULL;
+}
+
+/*
+ * replayRings - several producers (one ring each) feeding one cache
+ * Every ring is drained by its own thread into a shared cache, so producers
+ * that touch different sets proceed in parallel.
+ */
+void replayRings(shared_cache_t* shared, char** names, int count)
+{
+    pthread_t tids[MAX_RINGS];
+    ring_job_t jobs[MAX_RINGS];
+
+    for(int i = 0; i < count; i++) {
+        jobs[i].shared = shared;
+        jobs[i].name = names[i];
+        if(pthread_create(&tids[i], NULL, ringWorker, &jobs[i]) != 0) {
+            fprintf(stderr, "%s: can't start consumer thread\n", names[i]);
+            exit(1);
+        }
+    }
+
+    for(int i = 0; i < count; i++)
+        pthread_join(tids[i], NULL);
+}
+
+
+/****************************************************************************/
+/* Daemon mode
+ *
+ * csim -d <socket> keeps decoded traces and the statistics of every cache
+ * it has simulated resident, and answers queries (see csim_proto.h) from a
+ * pool of worker threads.  A repeated query is answered without touching
+ * the trace file again, a new geometry only pays for the simulation itself.
+ * A resident trace is dropped and decoded afresh as soon as the file
+ * changes on disk.
+ */
+
+/* Default number of worker threads (-j) */
+#define DAEMON_WORKERS 4
+/* Accepted connections waiting for a worker */
+#define DAEMON_QUEUE 64
+/* Largest cache (in lines) a query may ask for */
+#define DAEMON_MAX_LINES (1 << 26)
+
+char* daemon_socket = NULL; /* socket path, daemon mode if set */
+int daemon_workers = DAEMON_WORKERS;
+
+/* Statistics of one simulated geometry of a resident trace */
+typedef struct resident_result {
+    int s, E, b;
+    int hits, misses, evictions, straddles;
+    struct resident_result* next;
+} resident_result_t;
+
+/* A decoded trace, identified by its path and on-disk identity */
+typedef struct resident_trace {
+    char* path;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    access_t* recs;
+    size_t count;
+    int refs; // the table holds one reference while the trace is listed
+    resident_result_t* results;
+    struct resident_trace* next;
+} resident_trace_t;
+
+pthread_mutex_t resident_lock = PTHREAD_MUTEX_INITIALIZER;
+resident_trace_t* resident_traces = NULL;
+
+/* Connections handed from the accept loop to the workers */
+int conn_queue[DAEMON_QUEUE];
+int conn_head = 0, conn_count = 0;
+pthread_mutex_t conn_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t conn_ready = PTHREAD_COND_INITIALIZER;
+pthread_cond_t conn_space = PTHREAD_COND_INITIALIZER;
+
+volatile sig_atomic_t daemon_stop = 0;
+
+
+/*
+ * sameFile - is the resident trace still what is on disk?
+ */
+int sameFile(resident_trace_t* t, struct stat* st)
+{
+    return t->dev == st->st_dev && t->ino == st->st_ino &&
+           t->size == st->st_size &&
+           t->mtime.tv_sec == st->st_mtim.tv_sec &&
+           t->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+
+/*
+ * releaseTrace - drop one reference, freeing the trace with the last one
+ * Must be called with resident_lock held.
+ */
+void releaseTrace(resident_trace_t* t)
+{
+    if(--t->refs > 0)
+        return;
+
+    while(t->results) {
+        resident_result_t* r = t->results;
+        t->results = r->next;
+        free(r);
+    }
+    free(t->recs);
+    free(t->path);
+    free(t);
+}
+
+
+/*
+ * acquireTrace - find the resident copy of a trace, decoding it if it isn't
+ * resident yet or has changed on disk.  The caller owns one reference.
+ * Returns NULL and sets *err on failure.
+ */
+resident_trace_t* acquireTrace(const char* path, const char** err)
+{
+    struct stat st;
+    resident_trace_t** link;
+    resident_trace_t* t;
+
+    if(stat(path, &st) != 0) {
+        *err = strerror(errno);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&resident_lock);
+    for(link = &resident_traces; (t = *link) != NULL; link = &t->next) {
+        if(strcmp(t->path, path) != 0)
+            continue;
+
+        if(sameFile(t, &st)) {
+            t->refs++;
+            pthread_mutex_unlock(&resident_lock);
+            return t;
+        }
+
+        //stale, unlist it; queries still using it keep it alive
+        *link = t->next;
+        releaseTrace(t);
+        break;
+    }
+    pthread_mutex_unlock(&resident_lock);
+
+    //decode outside the lock so other queries aren't held up
+    t = calloc(1, sizeof(resident_trace_t));
+    t->recs = loadTrace(path, TRACE_AUTO, &t->count);
+    if(!t->recs) {
+        *err = strerror(errno);
+        free(t);
+        return NULL;
+    }
+    t->path = strdup(path);
+    t->dev = st.st_dev;
+    t->ino = st.st_ino;
+    t->size = st.st_size;
+    t->mtime = st.st_mtim;
+    t->refs = 2;
+
+    pthread_mutex_lock(&resident_lock);
+
+    //another worker may have decoded the same file in the meantime
+    for(resident_trace_t* other = resident_traces; other; other = other->next) {
+        if(strcmp(other->path, path) == 0 && sameFile(other, &st)) {
+            other->refs++;
+            t->refs = 1;
+            releaseTrace(t);
+            pthread_mutex_unlock(&resident_lock);
+            return other;
+        }
+    }
+
+    t->next = resident_traces;
+    resident_traces = t;
+    pthread_mutex_unlock(&resident_lock);
+    return t;
+}
+
+
+/*
+ * findResult - look up a resident result, with resident_lock held
+ */
+resident_result_t* findResult(resident_trace_t* t, int s, int E, int b)
+{
+    for(resident_result_t* r = t->results; r; r = r->next) {
+        if(r->s == s && r->E == E && r->b == b)
+            return r;
+    }
+    return NULL;
+}
+
+
+/*
+ * answerQuery - simulate (or look up) one geometry for one trace and format
+ * the JSON reply into out
+ */
+void answerQuery(const char* path, int s, int E, int b, char* out, size_t size)
+{
+    const char* err = NULL;
+    resident_result_t result;
+    int resident = 1;
+
+    //reject geometries we can't or shouldn't allocate
+    if(s < 0 || b < 0 || E < 1 || s > 30 || b > 30 || s + b > 63 ||
+       (long long)E << s > DAEMON_MAX_LINES) {
+        snprintf(out, size, "{\"error\":\"invalid cache geometry\"}\n");
+        return;
+    }
+
+    resident_trace_t* t = acquireTrace(path, &err);
+    if(!t) {
+        snprintf(out, size, "{\"error\":\"%s\"}\n", err);
+        return;
+    }
+
+    pthread_mutex_lock(&resident_lock);
+    resident_result_t* r = findResult(t, s, E, b);
+    if(r)
+        result = *r;
+    pthread_mutex_unlock(&resident_lock);
+
+    if(!r) {
+        cache_t c;
+        resident = 0;
+
+        initCache(&c, s, E, b);
+        for(size_t i = 0; i < t->count; i++)
+            simulateSpan(&c, t->recs[i].op, t->recs[i].addr, t->recs[i].len);
+        freeCache(&c);
+
+        result.s = s;
+        result.E = E;
+        result.b = b;
+        result.hits = c.hit_count;
+        result.misses = c.miss_count;
+        result.evictions = c.eviction_count;
+        result.straddles = c.straddle_count;
+
+        pthread_mutex_lock(&resident_lock);
+        if(!findResult(t, s, E, b)) {
+            r = malloc(sizeof(resident_result_t));
+            *r = result;
+            r->next = t->results;
+            t->results = r;
+        }
+        pthread_mutex_unlock(&resident_lock);
+    }
+
+    pthread_mutex_lock(&resident_lock);
+    releaseTrace(t);
+    pthread_mutex_unlock(&resident_lock);
+
+    //the path is echoed back, so escape what JSON can't carry verbatim
+    char escaped[2 * CSIM_PROTO_MAX_PATH + 1];
+    size_t k = 0;
+    for(const char* p = path; *p; p++) {
+        if(*p == '"' || *p == '\\')
+            escaped[k++] = '\\';
+        escaped[k++] = (unsigned char)*p < 0x20 ? '?' : *p;
+    }
+    escaped[k] = '\0';
+
+    int accesses = result.hits + result.misses;
+    snprintf(out, size,
+             "{\"trace\":\"%s\",\"s\":%d,\"E\":%d,\"b\":%d,"
+             "\"hits\":%d,\"misses\":%d,\"evictions\":%d,\"straddles\":%d,"
+             "\"miss_ratio\":%f,\"resident\":%s}\n",
+             escaped, s, E, b, result.hits, result.misses, result.evictions,
+             result.straddles,
+             accesses ? (double)result.misses / accesses : 0.0,
+             resident ? "true" : "false");
+}
+
+
+/*
+ * readFull/writeFull - move exactly len bytes over a socket
+ * readFull returns 0 on a clean EOF before any byte was read.
+ */
+int readFull(int fd, void* buf, size_t len)
+{
+    size_t done = 0;
+    while(done < len) {
+        ssize_t n = read(fd, (char*)buf + done, len - done);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return done == 0 && n == 0 ? 0 : -1;
+        done += n;
+    }
+    return 1;
+}
+
+int writeFull(int fd, const void* buf, size_t len)
+{
+    size_t done = 0;
+    while(done < len) {
+        ssize_t n = send(fd, (const char*)buf + done, len - done, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return -1;
+        done += n;
+    }
+    return 1;
+}
+
+
+/*
+ * serveClient - answer queries on one connection until the client is done
+ */
+void serveClient(int fd)
+{
+    csim_query_t q;
+    char path[CSIM_PROTO_MAX_PATH + 1];
+    char reply[3 * CSIM_PROTO_MAX_PATH];
+
+    while(readFull(fd, &q, sizeof(q)) == 1) {
+        if(q.magic != CSIM_PROTO_MAGIC || q.path_len == 0 ||
+           q.path_len > CSIM_PROTO_MAX_PATH) {
+            const char* bad = "{\"error\":\"malformed query\"}\n";
+            writeFull(fd, bad, strlen(bad));
+            break;
+        }
+        if(readFull(fd, path, q.path_len) != 1)
+            break;
+        path[q.path_len] = '\0';
+
+        answerQuery(path, (int)q.s, (int)q.E, (int)q.b, reply, sizeof(reply));
+
+        if(verbosity)
+            fprintf(stderr, "query %s s=%u E=%u b=%u: %s", path, q.s, q.E,
+                    q.b, reply);
+
+        if(writeFull(fd, reply, strlen(reply)) != 1)
+            break;
+    }
+
+    close(fd);
+}
+
+
+/*
+ * daemonWorker - thread pool body, serves queued connections forever
+ */
+void* daemonWorker(void* arg)
+{
+    (void)arg;
+
+    while(1) {
+        pthread_mutex_lock(&conn_lock);
+        while(conn_count == 0)
+            pthread_cond_wait(&conn_ready, &conn_lock);
+        int fd = conn_queue[conn_head];
+        conn_head = (conn_head + 1) % DAEMON_QUEUE;
+        conn_count--;
+        pthread_cond_signal(&conn_space);
+        pthread_mutex_unlock(&conn_lock);
+
+        serveClient(fd);
+    }
+    return NULL;
+}
+
+
+void stopDaemon(int sig)
+{
+    (void)sig;
+    daemon_stop = 1;
+}
+
+
+/*
+ * runDaemon - listen on a Unix domain socket and hand every connection to
+ * the worker pool, until SIGINT or SIGTERM
+ */
+void runDaemon(char* socket_path)
+{
+    struct sockaddr_un sa;
+    struct sigaction stop;
+
+    if(strlen(socket_path) >= sizeof(sa.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", socket_path);
+        exit(1);
+    }
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, socket_path);
+    unlink(socket_path);
+
+    if(lfd < 0 || bind(lfd, (struct sockaddr*)&sa, sizeof(sa)) != 0 ||
+       listen(lfd, DAEMON_QUEUE) != 0) {
+        fprintf(stderr, "%s: %s\n", socket_path, strerror(errno));
+        exit(1);
+    }
+
+    //no SA_RESTART, so a signal breaks us out of accept()
+    memset(&stop, 0, sizeof(stop));
+    stop.sa_handler = stopDaemon;
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    for(int i = 0; i < daemon_workers; i++) {
+        pthread_t tid;
+        if(pthread_create(&tid, NULL, daemonWorker, NULL) != 0) {
+            fprintf(stderr, "%s: can't start worker threads\n", socket_path);
+            exit(1);
+        }
+        pthread_detach(tid);
+    }
+
+    if(verbosity)
+        fprintf(stderr, "csim daemon listening on %s with %d workers\n",
+                socket_path, daemon_workers);
+
+    while(!daemon_stop) {
+        int fd = accept(lfd, NULL, NULL);
+        if(fd < 0) {
+            if(errno == EINTR || errno == ECONNABORTED)
+                continue;
+            fprintf(stderr, "%s: %s\n", socket_path, strerror(errno));
+            break;
+        }
+
+        pthread_mutex_lock(&conn_lock);
+        while(conn_count == DAEMON_QUEUE)
+            pthread_cond_wait(&conn_space, &conn_lock);
+        conn_queue[(conn_head + conn_count) % DAEMON_QUEUE] = fd;
+        conn_count++;
+        pthread_cond_signal(&conn_ready);
+        pthread_mutex_unlock(&conn_lock);
+    }
+
+    close(lfd);
+    unlink(socket_path);
+}
+
+/****************************************************************************/
+/* Result memo
+ *
+ * Every plain trace run appends its result to an append-only text file
+ * (.csim_memo unless --memo says otherwise), one line per result:
+ *
+ *     <content hash> <dev> <ino> <size> <mtime> <hits> <misses> <evictions> <config>
+ *
+ * A later run with the same configuration first looks for the trace's
+ * identity (device, inode, size, mtime), which only needs a stat(), and
+ * answers without opening the trace.  If the file has been touched, its
+ * contents are hashed instead: equal contents still reuse the result (and
+ * the new identity is appended), changed contents miss and are simulated.
+ */
+
+#define MEMO_FILE ".csim_memo"
+/* Bump whenever the simulator's results change for the same config */
+#define MEMO_VERSION 2
+
+char* memo_file = MEMO_FILE;
+int memo_enabled = 1; /* cleared by --no-cache */
+uint64_t region_hash = HASH_SEED; /* of the options that pick the regions */
+
+typedef struct memo_key {
+    unsigned long long dev, ino, size;
+    long long mtime_sec, mtime_nsec;
+    uint64_t hash;
+    int hashed;
+    char config[128];
+} memo_key_t;
+
+
+/*
+ * memoConfig - every setting that changes the result of a run, as one token
+ */
+void memoConfig(char* buf, size_t size)
+{
+    int n = snprintf(buf, size, "v%d,s=%d,E=%d,b=%d,warmup=%lld,format=%s",
+                     MEMO_VERSION, s, E, b, warmup, traceFormatName(trace_format));
+
+    //the regions only matter when some are dropped
+    if(only_regions && n >= 0 && (size_t)n < size)
+        n += snprintf(buf + n, size - n, ",only=%016" PRIx64, region_hash);
+    if(index_spec && n >= 0 && (size_t)n < size)
+        n += snprintf(buf + n, size - n, ",index=%016" PRIx64,
+                      hashBytes(index_spec, strlen(index_spec), HASH_SEED));
+    if(org_spec && n >= 0 && (size_t)n < size)
+        snprintf(buf + n, size - n, ",org=%016" PRIx64,
+                 hashBytes(org_spec, strlen(org_spec), HASH_SEED));
+}
+
+
+/*
+ * hashFile - content hash of a whole trace file, 0 if it can't be read
+ */
+uint64_t hashFile(const char* path)
+{
+    char buf[65536];
+    size_t n;
+    uint64_t h = HASH_SEED;
+    FILE* fp = fopen(path, "rb");
+
+    if(!fp)
+        return 0;
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        h = hashBytes(buf, n, h);
+    fclose(fp);
+    return h;
+}
+
+
+/*
+ * memoStore - append one result; a single short write, so concurrent runs
+ * appending to the same memo never interleave their lines
+ */
+void memoStore(const char* trace_fn, memo_key_t* key, int hits, int misses,
+               int evictions, int straddles)
+{
+    char line[512];
+
+    if(!key->hashed) {
+        key->hash = hashFile(trace_fn);
+        key->hashed = 1;
+    }
+
+    int n = snprintf(line, sizeof(line),
+                     "%016" PRIx64 " %llu %llu %llu %lld.%09lld %d %d %d %d %s\n",
+                     key->hash, key->dev, key->ino, key->size, key->mtime_sec,
+                     key->mtime_nsec, hits, misses, evictions, straddles,
+                     key->config);
+
+    int fd = open(memo_file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if(fd < 0 || write(fd, line, n) != n)
+        fprintf(stderr, "%s: %s\n", memo_file, strerror(errno));
+    if(fd >= 0)
+        close(fd);
+}
+
+
+/*
+ * memoLookup - look for a stored result of this configuration for the
+ * trace, filling in key for a later memoStore() either way.
+ * Returns 1 with the counters set on a hit.
+ */
+int memoLookup(const char* trace_fn, memo_key_t* key, int* hits, int* misses,
+               int* evictions, int* straddles)
+{
+    struct stat st;
+    char line[512], config[128];
+    memo_key_t rec;
+    int h, m, ev, str;
+    int found = 0;
+
+    memset(key, 0, sizeof(*key));
+    memoConfig(key->config, sizeof(key->config));
+    if(stat(trace_fn, &st) != 0)
+        return 0;
+    key->dev = st.st_dev;
+    key->ino = st.st_ino;
+    key->size = st.st_size;
+    key->mtime_sec = st.st_mtim.tv_sec;
+    key->mtime_nsec = st.st_mtim.tv_nsec;
+
+    FILE* fp = fopen(memo_file, "r");
+    if(!fp)
+        return 0;
+
+    //first pass: same file, untouched since it was simulated
+    while(!found && fgets(line, sizeof(line), fp)) {
+        if(sscanf(line, "%" SCNx64 " %llu %llu %llu %lld.%lld %d %d %d %d %127s",
+                  &rec.hash, &rec.dev, &rec.ino, &rec.size, &rec.mtime_sec,
+                  &rec.mtime_nsec, &h, &m, &ev, &str, config) != 11)
+            continue;
+        if(rec.dev == key->dev && rec.ino == key->ino &&
+           rec.size == key->size && rec.mtime_sec == key->mtime_sec &&
+           rec.mtime_nsec == key->mtime_nsec &&
+           strcmp(config, key->config) == 0)
+            found = 1;
+    }
+
+    //second pass: the file was touched, but maybe not changed
+    if(!found) {
+        key->hash = hashFile(trace_fn);
+        key->hashed = 1;
+        rewind(fp);
+        while(!found && fgets(line, sizeof(line), fp)) {
+            if(sscanf(line, "%" SCNx64 " %*u %*u %*u %*d.%*d %d %d %d %d %127s",
+                      &rec.hash, &h, &m, &ev, &str, config) != 6)
+                continue;
+            if(rec.hash == key->hash && strcmp(config, key->config) == 0) {
+                found = 1;
+                memoStore(trace_fn, key, h, m, ev, str);
+            }
+        }
+    }
+
+    fclose(fp);
+    if(found) {
+        *hits = h;
+        *misses = m;
+        *evictions = ev;
+        *straddles = str;
+    }
+    return found;
+}
+
+
 /*
  * printUsage - Print usage info
  */
 void printUsage(char* argv[])
 {
-    printf("Usage: %s [-hv] -s <num> -E <num> -b <num> -t <file>\n", argv[0]);
+    printf("Usage: %s [-hv] -s <num> -E <num> -b <num> -t <file>|-r <ring>\n", argv[0]);
+    printf("       %s [-v] [-j <num>] -d <socket>\n", argv[0]);
     printf("Options:\n");
     printf("  -h         Print this help message.\n");
     printf("  -v         Optional verbose flag.\n");
@@ -309,9 +1403,55 @@ void printUsage(char* argv[])
     printf("  -E <num>   Number of lines per set.\n");
     printf("  -b <num>   Number of block offset bits.\n");
     printf("  -t <file>  Trace file.\n");
+    printf("  --format <fmt>  Trace format: lackey, pinatrace, drmemtrace,\n"
+           "                  champsim or auto (default).\n");
+    printf("  -r <ring>  Shared-memory ring to consume (shm name or fd:N).\n");
+    printf("             Repeat to let several producers share the cache.\n");
+    printf("  -d <sock>  Run as a daemon answering queries on a Unix socket.\n");
+    printf("  -j <num>   Number of daemon worker threads (default %d).\n",
+           DAEMON_WORKERS);
+    printf("  --warmup <num>       Leave the first <num> records out of the stats.\n");
+    printf("  --save-state <file>  Save the final cache state to <file>.\n");
+    printf("  --load-state <file>  Start from a saved cache state instead of a\n"
+           "                       cold cache (-s, -E and -b may be omitted).\n");
+    printf("  --checkpoint <file>  Checkpoint the run to <file> and resume from it,\n"
+           "                       replaying only records added since.\n");
+    printf("  --checkpoint-every <num>  Records between checkpoints (default %d).\n",
+           CHECKPOINT_EVERY);
+    printf("  --index <fn>         Set index function: bits (default), xor,\n"
+           "                       prime[:<sets>], matrix:<mask>,... or slice[:<n>].\n");
+    printf("  --org <org>          Organisation: set (default), skew or\n"
+           "                       zcache[:<levels>], optionally with ,lru or ,rrip.\n");
+    printf("  --sectors <num>      Make each line a sector of <num> sub-blocks, each\n"
+           "                       fetched on its own (a power of two up to 64).\n");
+    printf("  --block-sizes <b,...>  Compare these block offset bits in one pass, on\n"
+           "                       caches as large as the -s/-E/-b one.\n");
+    printf("  --memo <file>        Remember results in <file> (default %s).\n",
+           MEMO_FILE);
+    printf("  --no-cache           Always simulate, don't use remembered results.\n");
+    printf("  --by-region          Also report the statistics of each address region.\n");
+    printf("  --only-region <names>  Simulate only the accesses to these regions\n"
+           "                       (comma separated).\n");
+    printf("  --region <name=lo-hi>  Name an address range (hex, hi exclusive);\n"
+           "                       repeat for more.  Without any, addresses are\n"
+           "                       grouped by their top bits into stack, heap,\n"
+           "                       globals and mmap.\n");
+    printf("  --region-bits <num>  Group by blocks of 2^<num> bytes (default %d).\n",
+           REGION_BITS);
+    printf("  --symbols <file>     Also report the statistics of each variable of the\n"
+           "                       traced program (its ELF file, or nm -S output).\n");
+    printf("  --symbol-base <hex>  Address the program was loaded at, if PIE.\n");
+    printf("  --malloc-log <file>  Also report the statistics of each heap allocation\n"
+           "                       site, from a log of libcsim-malloc.so.\n");
     printf("\nExamples:\n");
     printf("  linux>  %s -s 4 -E 1 -b 4 -t traces/yi.trace\n", argv[0]);
     printf("  linux>  %s -v -s 8 -E 2 -b 4 -t traces/yi.trace\n", argv[0]);
+    printf("  linux>  %s -s 8 -E 2 -b 4 -r /myapp\n", argv[0]);
+    printf("  linux>  %s -j 8 -d /tmp/csim.sock\n", argv[0]);
+    printf("  linux>  %s -s 4 -E 1 -b 4 --warmup 100 -t traces/long.trace\n", argv[0]);
+    printf("  linux>  %s -s 5 -E 1 -b 5 --only-region stack -t traces/long.trace\n",
+           argv[0]);
+    printf("  linux>  %s -s 5 -E 1 -b 5 --symbols ./tracegen -t trace.f0\n", argv[0]);
     exit(0);
 }
 
@@ -320,10 +1460,41 @@ void printUsage(char* argv[])
  */
 int main(int argc, char* argv[])
 {
-    char c;
+    int c;
+    enum { OPT_SAVE_STATE = 256, OPT_LOAD_STATE, OPT_CHECKPOINT,
+           OPT_CHECKPOINT_EVERY, OPT_MEMO, OPT_NO_CACHE, OPT_FORMAT,
+           OPT_BY_REGION, OPT_ONLY_REGION, OPT_REGION, OPT_REGION_BITS,
+           OPT_SYMBOLS, OPT_SYMBOL_BASE, OPT_MALLOC_LOG, OPT_INDEX,
+           OPT_ORG, OPT_SECTORS, OPT_BLOCK_SIZES };
+    static struct option long_options[] = {
+        {"warmup",           required_argument, NULL, 'w'},
+        {"save-state",       required_argument, NULL, OPT_SAVE_STATE},
+        {"load-state",       required_argument, NULL, OPT_LOAD_STATE},
+        {"checkpoint",       required_argument, NULL, OPT_CHECKPOINT},
+        {"checkpoint-every", required_argument, NULL, OPT_CHECKPOINT_EVERY},
+        {"memo",             required_argument, NULL, OPT_MEMO},
+        {"no-cache",         no_argument,       NULL, OPT_NO_CACHE},
+        {"format",           required_argument, NULL, OPT_FORMAT},
+        {"by-region",        no_argument,       NULL, OPT_BY_REGION},
+        {"only-region",      required_argument, NULL, OPT_ONLY_REGION},
+        {"region",           required_argument, NULL, OPT_REGION},
+        {"region-bits",      required_argument, NULL, OPT_REGION_BITS},
+        {"symbols",          required_argument, NULL, OPT_SYMBOLS},
+        {"symbol-base",      required_argument, NULL, OPT_SYMBOL_BASE},
+        {"malloc-log",       required_argument, NULL, OPT_MALLOC_LOG},
+        {"index",            required_argument, NULL, OPT_INDEX},
+        {"org",              required_argument, NULL, OPT_ORG},
+        {"sectors",          required_argument, NULL, OPT_SECTORS},
+        {"block-sizes",      required_argument, NULL, OPT_BLOCK_SIZES},
+        {NULL, 0, NULL, 0}
+    };
+    int region_bits = REGION_BITS;
+
+    initRegionTable(&regions, region_bits);
     
-    // Parse the command line arguments: -h, -v, -s, -E, -b, -t 
-    while( (c=getopt(argc,argv,"s:E:b:t:vh")) != -1){
+    // Parse the command line arguments: -h, -v, -s, -E, -b, -t, -r, -d, -j
+    // and the long options above
+    while( (c=getopt_long(argc,argv,"s:E:b:t:r:d:j:vh",long_options,NULL)) != -1){
         switch(c){
         case 's':
             s = atoi(optarg);
@@ -337,6 +1508,88 @@ int main(int argc, char* argv[])
         case 't':
             trace_file = optarg;
             break;
+        case 'r':
+            if (ring_count == MAX_RINGS) {
+                printf("%s: at most %d rings\n", argv[0], MAX_RINGS);
+                exit(1);
+            }
+            ring_names[ring_count++] = optarg;
+            break;
+        case 'd':
+            daemon_socket = optarg;
+            break;
+        case 'j':
+            daemon_workers = atoi(optarg);
+            break;
+        case 'w':
+            warmup = atoll(optarg);
+            break;
+        case OPT_SAVE_STATE:
+            save_state = optarg;
+            break;
+        case OPT_LOAD_STATE:
+            load_state = optarg;
+            break;
+        case OPT_CHECKPOINT:
+            checkpoint_file = optarg;
+            break;
+        case OPT_CHECKPOINT_EVERY:
+            checkpoint_every = atoll(optarg);
+            break;
+        case OPT_MEMO:
+            memo_file = optarg;
+            break;
+        case OPT_NO_CACHE:
+            memo_enabled = 0;
+            break;
+        case OPT_FORMAT:
+            if (parseTraceFormat(optarg) < 0) {
+                printf("%s: unknown trace format %s\n", argv[0], optarg);
+                exit(1);
+            }
+            trace_format = parseTraceFormat(optarg);
+            break;
+        case OPT_BY_REGION:
+            by_region = 1;
+            break;
+        case OPT_ONLY_REGION:
+            only_regions = optarg;
+            break;
+        case OPT_REGION:
+            if (addNamedRegion(&regions, optarg) != 0) {
+                printf("%s: bad or overlapping region %s\n", argv[0], optarg);
+                exit(1);
+            }
+            region_hash = hashBytes(optarg, strlen(optarg) + 1, region_hash);
+            break;
+        case OPT_REGION_BITS:
+            region_bits = atoi(optarg);
+            if (region_bits < 1 || region_bits > 63) {
+                printf("%s: --region-bits must be between 1 and 63\n", argv[0]);
+                exit(1);
+            }
+            break;
+        case OPT_SYMBOLS:
+            symbol_file = optarg;
+            break;
+        case OPT_SYMBOL_BASE:
+            symbol_base = strtoull(optarg, NULL, 16);
+            break;
+        case OPT_MALLOC_LOG:
+            malloc_log = optarg;
+            break;
+        case OPT_INDEX:
+            index_spec = optarg;
+            break;
+        case OPT_ORG:
+            org_spec = optarg;
+            break;
+        case OPT_SECTORS:
+            sectors = atoi(optarg);
+            break;
+        case OPT_BLOCK_SIZES:
+            block_sizes = optarg;
+            break;
         case 'v':
             verbosity = 1;
             break;
@@ -349,27 +1602,246 @@ int main(int argc, char* argv[])
         }
     }
 
+    /* The daemon takes the geometry from each query instead */
+    if (daemon_socket) {
+        if (daemon_workers < 1) {
+            printf("%s: -j needs at least one worker\n", argv[0]);
+            exit(1);
+        }
+        runDaemon(daemon_socket);
+        return 0;
+    }
+
     /* Make sure that all required command line args were specified */
-    if (s == 0 || E == 0 || b == 0 || trace_file == NULL) {
+    if ((load_state == NULL && (s == 0 || E == 0 || b == 0)) ||
+        (trace_file == NULL && ring_count == 0)) {
         printf("%s: Missing required command line argument\n", argv[0]);
         printUsage(argv);
         exit(1);
     }
 
 
-    /* Initialize cache */
-    initCache();
+    if (checkpoint_file && (load_state || trace_file == NULL || checkpoint_every < 1)) {
+        printf("%s: --checkpoint needs a trace file (-t) and no --load-state\n",
+               argv[0]);
+        exit(1);
+    }
+
+    /* Hashed set indexes aren't recorded in cache states */
+    cache_index_t index;
+    if (index_spec) {
+        if (parseCacheIndex(&index, index_spec, s) != 0) {
+            printf("%s: bad set index function %s for -s %d\n", argv[0],
+                   index_spec, s);
+            exit(1);
+        }
+        if (save_state || load_state || checkpoint_file || ring_count > 1) {
+            printf("%s: --index needs a single input and no cache states\n",
+                   argv[0]);
+            exit(1);
+        }
+    }
+
+    /* Nor are organisations, which have no sets to index */
+    cache_org_t org;
+    if (org_spec) {
+        if (parseCacheOrg(&org, org_spec, s, E) != 0) {
+            printf("%s: bad organisation %s for -s %d -E %d\n", argv[0],
+                   org_spec, s, E);
+            exit(1);
+        }
+        if (save_state || load_state || checkpoint_file || ring_count > 1 ||
+            (index_spec && org.kind != ORG_SET)) {
+            printf("%s: --org needs a single input, no cache states and no "
+                   "--index\n", argv[0]);
+            exit(1);
+        }
+    }
+
+    /* Nor are sub-blocks, which only set-associative caches have */
+    int sub_bits = 0;
+    if (sectors) {
+        while (sub_bits < 6 && 1 << sub_bits < sectors)
+            sub_bits++;
+        if (sectors < 1 || 1 << sub_bits != sectors || sub_bits > b) {
+            printf("%s: --sectors must be a power of two up to 64 and 2^b\n",
+                   argv[0]);
+            exit(1);
+        }
+        if (save_state || load_state || checkpoint_file || ring_count > 1 ||
+            (org_spec && org.kind != ORG_SET)) {
+            printf("%s: --sectors needs a single input, no cache states and no "
+                   "skewed --org\n", argv[0]);
+            exit(1);
+        }
+    }
+
+    /* Regions: explicit ranges, or grouped by address bits */
+    if (regions.count == 0)
+        regions.bits = region_bits;
+    else
+        region_bits = 0;
+    memset(region_kept, -1, sizeof(region_kept));
+    if (only_regions) {
+        //every name kept has to be one of the explicit ranges, or one the
+        //automatic classification gives
+        for (char* p = only_regions; p; ) {
+            size_t len = strcspn(p, ",");
+            int known = regions.count == 0 && isAutoRegion(p, len);
+
+            for (int r = 0; r < regions.count; r++)
+                known |= strlen(regions.names[r]) == len &&
+                         strncmp(regions.names[r], p, len) == 0;
+            if (!known) {
+                printf("%s: no region called %.*s%s\n", argv[0], (int)len, p,
+                       regions.count ? "" : " (automatic regions are stack, "
+                       "heap, globals and mmap)");
+                exit(1);
+            }
+            p = p[len] ? p + len + 1 : NULL;
+        }
+        region_hash = hashBytes(only_regions, strlen(only_regions) + 1, region_hash);
+        region_hash = hashBytes(&region_bits, sizeof(region_bits), region_hash);
+    }
+    if ((by_region || only_regions || symbol_file || malloc_log) &&
+        (checkpoint_file || ring_count > 1)) {
+        printf("%s: --by-region, --only-region, --symbols and --malloc-log need a "
+               "single input and no --checkpoint\n", argv[0]);
+        exit(1);
+    }
+    if (symbol_file) {
+        if (loadSymbols(&symbols, symbol_file, symbol_base) != 0) {
+            fprintf(stderr, "%s: %s\n", symbol_file, errno == EINVAL ?
+                    "neither an ELF file nor nm output" : strerror(errno));
+            exit(1);
+        }
+        symbol_stats = calloc(symbols.count + 1, sizeof(access_stats_t));
+    }
+    if (malloc_log) {
+        if (loadAllocLog(&allocs, malloc_log) != 0) {
+            fprintf(stderr, "%s: %s\n", malloc_log, errno == EINVAL ?
+                    "not a csim-malloc log" : strerror(errno));
+            exit(1);
+        }
+        site_stats = calloc(allocs.site_count + 1, sizeof(access_stats_t));
+    }
+
+    /* Several producers share one cache, each ring in its own thread */
+    if (ring_count > 1) {
+        shared_cache_t shared;
+
+        if (warmup || save_state || load_state) {
+            printf("%s: --warmup and cache states need a single input\n", argv[0]);
+            exit(1);
+        }
+        int hits, misses, evictions, straddles;
+
+        initSharedCache(&shared, s, E, b);
+        replayRings(&shared, ring_names, ring_count);
+        sharedCacheStats(&shared, &hits, &misses, &evictions, &straddles);
+        freeSharedCache(&shared);
+        if (straddles)
+            printf("straddles:%d\n", straddles);
+        printSummary(hits, misses, evictions);
+        return 0;
+    }
+
+    /* A line size study: every cache fed by one decode of the trace */
+    if (block_sizes) {
+        if (!trace_file || ring_count || save_state || load_state ||
+            checkpoint_file || verbosity || by_region || symbol_file ||
+            malloc_log) {
+            printf("%s: --block-sizes needs a trace file (-t) and no cache "
+                   "states, -v or per-access reports\n", argv[0]);
+            exit(1);
+        }
+        replayBlockSizes(trace_file);
+        return 0;
+    }
+
+    /* A plain trace run may already have been answered */
+    memo_key_t memo_key;
+    int use_memo = memo_enabled && trace_file && !ring_count && !load_state &&
+                   !save_state && !checkpoint_file && !verbosity && !by_region &&
+                   !symbol_file && !malloc_log && !sectors;
+    if (use_memo) {
+        int hits, misses, evictions, straddles;
+        if (memoLookup(trace_file, &memo_key, &hits, &misses, &evictions,
+                       &straddles)) {
+            if (straddles)
+                printf("straddles:%d\n", straddles);
+            printSummary(hits, misses, evictions);
+            return 0;
+        }
+    }
+
+    /* Initialize cache, cold or from a saved state */
+    if (load_state) {
+        if (loadCache(&cache, load_state, NULL) != 0) {
+            fprintf(stderr, "%s: %s\n", load_state,
+                    errno == EINVAL ? "not a csim cache state" : strerror(errno));
+            exit(1);
+        }
+        if ((s && s != cache.s) || (E && E != cache.E) || (b && b != cache.b)) {
+            fprintf(stderr, "%s: saved with -s %d -E %d -b %d\n", load_state,
+                    cache.s, cache.E, cache.b);
+            exit(1);
+        }
+
+        //start warm, but only count this run's accesses
+        clearStats(&cache);
+    } else if (!checkpoint_file || !resumeTrace(&cache, trace_file, &trace_pos)) {
+        initRunCache(&cache, s, E, b);
+        memset(&trace_pos, 0, sizeof(trace_pos));
+    }
 
 #ifdef DEBUG_ON
-    printf("DEBUG: S:%u E:%u B:%u trace:%s\n", S, E, B, trace_file);
+    printf("DEBUG: S:%u E:%u B:%u trace:%s\n", cache.S, E, cache.B, trace_file);
 #endif
  
-    replayTrace(trace_file);
+    if (ring_count)
+        replayRing(&cache, ring_names[0]);
+    else
+        replayTrace(&cache, trace_file, checkpoint_file ? &trace_pos : NULL);
+
+    /* Records that never got past the warm-up (here or in the runs the
+     * checkpoint resumes) only warmed the cache up */
+    if (warmup > 0)
+        endWarmup(&cache);
+
+    if (save_state && saveCache(&cache, save_state, NULL) != 0) {
+        fprintf(stderr, "%s: %s\n", save_state, strerror(errno));
+        exit(1);
+    }
 
     /* Free allocated memory */
-    freeCache();
+    freeCache(&cache);
+
+    if (use_memo)
+        memoStore(trace_file, &memo_key, cache.hit_count, cache.miss_count,
+                  cache.eviction_count, cache.straddle_count);
+
+    if (by_region)
+        printRegions();
+    if (symbol_stats) {
+        printSymbols();
+        free(symbol_stats);
+        freeSymbols(&symbols);
+    }
+    if (site_stats) {
+        printSites();
+        free(site_stats);
+        freeAllocLog(&allocs);
+    }
+
+    if (sectors)
+        printf("tag-misses:%d subblock-misses:%d fill-bytes:%lld "
+               "writeback-bytes:%lld\n", cache.miss_count - cache.sub_miss_count,
+               cache.sub_miss_count, cache.fill_bytes, cache.writeback_bytes);
+    if (cache.straddle_count)
+        printf("straddles:%d\n", cache.straddle_count);
 
     /* Output the hit and miss statistics for the autograder */
-    printSummary(hit_count, miss_count, eviction_count);
+    printSummary(cache.hit_count, cache.miss_count, cache.eviction_count);
     return 0;
 }
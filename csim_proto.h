@@ -0,0 +1,33 @@
+/*
+ * csim_proto.h - Wire format spoken by the csim daemon (csim -d <socket>)
+ *
+ * A client connects to the daemon's Unix domain socket and sends one or
+ * more queries, each a csim_query_t immediately followed by path_len bytes
+ * of trace file path (no terminating NUL).  For every query the daemon
+ * answers with a single line of JSON, for example
+ *
+ *     {"trace":"traces/yi.trace","s":4,"E":1,"b":4,"hits":4,"misses":5,
+ *      "evictions":3,"straddles":0,"miss_ratio":0.555556,"resident":true}
+ *
+ * where straddles counts the records split across blocks, or
+ * {"error":"..."} if the query could not be answered.  Queries on one
+ * connection are answered in order; the connection stays open until the
+ * client closes it.  All fields are in host byte order.
+ */
+#ifndef CSIM_PROTO_H
+#define CSIM_PROTO_H
+
+#include <stdint.h>
+
+#define CSIM_PROTO_MAGIC 0x31515343u  /* "CSQ1" */
+#define CSIM_PROTO_MAX_PATH 4096
+
+typedef struct csim_query {
+    uint32_t magic;
+    uint32_t s;         /* set index bits */
+    uint32_t E;         /* associativity */
+    uint32_t b;         /* block offset bits */
+    uint32_t path_len;  /* bytes of trace path that follow */
+} csim_query_t;
+
+#endif /* CSIM_PROTO_H */
@@ -0,0 +1,130 @@
+/*
+ * csim_ring.h - Shared-memory ring buffer for streaming memory accesses
+ *     from an instrumented program straight into csim, without writing
+ *     a trace file.
+ *
+ * The ring lives in a POSIX shared-memory object (shm_open) or a memfd and
+ * has exactly one producer (the instrumented program) and one consumer
+ * (csim -r).  Both sides only ever advance their own index, so no locks are
+ * needed: the producer fills slots and publishes them with a release store
+ * to head, the consumer reads them in place and hands them back with a
+ * release store to tail.
+ *
+ * Producer side:
+ *
+ *     csim_ring_t* ring = csim_ring_create("/myapp", 1 << 16);
+ *     ...
+ *     csim_ring_push(ring, (uint64_t)&x, sizeof(x), 'L');
+ *     ...
+ *     csim_ring_close(ring);
+ *
+ * Files including this header must enable POSIX declarations (for example
+ * by defining _POSIX_C_SOURCE 200809L) before any system header.
+ */
+#ifndef CSIM_RING_H
+#define CSIM_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define CSIM_RING_MAGIC   0x474e5243u  /* "CRNG" */
+#define CSIM_RING_VERSION 1
+
+/* One memory access, as written by the producer */
+typedef struct csim_ring_rec {
+    uint64_t addr;
+    uint32_t len;
+    char op;        /* 'L', 'S' or 'M', same meaning as in a Valgrind trace */
+    char pad[3];
+} csim_ring_rec_t;
+
+/*
+ * Ring header, followed by capacity records.  head and tail are free-running
+ * counters on separate cache lines; slot i lives at recs[i & (capacity-1)].
+ */
+typedef struct csim_ring {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;      /* number of records, a power of two */
+    uint32_t closed;        /* set by the producer once it is done */
+    char pad0[44];
+    uint64_t head;          /* written by the producer only */
+    char pad1[56];
+    uint64_t tail;          /* written by the consumer only */
+    char pad2[56];
+    csim_ring_rec_t recs[];
+} csim_ring_t;
+
+/* Bytes needed for a ring holding capacity records */
+static inline size_t csim_ring_size(uint64_t capacity)
+{
+    return sizeof(csim_ring_t) + capacity * sizeof(csim_ring_rec_t);
+}
+
+/* Initialize a freshly mapped ring; capacity must be a power of two */
+static inline void csim_ring_init(csim_ring_t* ring, uint64_t capacity)
+{
+    ring->capacity = capacity;
+    ring->closed = 0;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->version = CSIM_RING_VERSION;
+    __atomic_store_n(&ring->magic, CSIM_RING_MAGIC, __ATOMIC_RELEASE);
+}
+
+/*
+ * csim_ring_create - Create (or replace) the shared-memory object name and
+ *     map a ring of the given capacity into it.  Returns NULL on failure.
+ */
+static inline csim_ring_t* csim_ring_create(const char* name, uint64_t capacity)
+{
+    size_t size = csim_ring_size(capacity);
+    int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0600);
+    if (fd < 0)
+        return NULL;
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return NULL;
+    }
+    void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return NULL;
+    csim_ring_init((csim_ring_t*)mem, capacity);
+    return (csim_ring_t*)mem;
+}
+
+/* csim_ring_try_push - Append one access; returns 0 if the ring is full */
+static inline int csim_ring_try_push(csim_ring_t* ring, uint64_t addr,
+                                     uint32_t len, char op)
+{
+    uint64_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == ring->capacity)
+        return 0;
+    csim_ring_rec_t* rec = &ring->recs[head & (ring->capacity - 1)];
+    rec->addr = addr;
+    rec->len = len;
+    rec->op = op;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/* csim_ring_push - Append one access, waiting for the consumer if full */
+static inline void csim_ring_push(csim_ring_t* ring, uint64_t addr,
+                                  uint32_t len, char op)
+{
+    while (!csim_ring_try_push(ring, addr, len, op))
+        sched_yield();
+}
+
+/* csim_ring_close - Tell the consumer that no more accesses will follow */
+static inline void csim_ring_close(csim_ring_t* ring)
+{
+    __atomic_store_n(&ring->closed, 1, __ATOMIC_RELEASE);
+}
+
+#endif /* CSIM_RING_H */
@@ -0,0 +1,373 @@
+/*
+ * gen.c - Synthetic access streams, see gen.h for the patterns
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gen.h"
+#include "random.h"
+
+/* Largest footprint, in elements, of the patterns that keep a table
+ * (zipf and chase) */
+#define GEN_MAX_TABLE (1 << 26)
+
+/* Where streams start unless told otherwise, clear of address 0 (which
+ * ChampSim traces can't express) */
+#define GEN_DEFAULT_BASE 0x10000000ULL
+
+/* Longest run of buckets a hash lookup probes */
+#define HASH_MAX_PROBE 4
+
+static const char* pattern_names[] = {
+	"stride", "uniform", "zipf", "chase", "stencil2d", "stencil3d",
+	"matmul", "hash"
+};
+
+
+const char* genPatternName(gen_pattern_t pattern)
+{
+	return pattern_names[pattern];
+}
+
+int parseGenPattern(const char* name)
+{
+	for(int i = 0; i < GEN_PATTERNS; i++) {
+		if(strcmp(name, pattern_names[i]) == 0)
+			return i;
+	}
+	return -1;
+}
+
+
+/* Do count and the end of the stream go by sweeps rather than steps? */
+static int bySweeps(gen_pattern_t pattern)
+{
+	return pattern == GEN_STENCIL2D || pattern == GEN_STENCIL3D || pattern == GEN_MATMUL;
+}
+
+
+/* A load, or with the configured probability a store */
+static char randomOp(gen_t* gen)
+{
+	return gen->p.writes && (int)randomBelow(&gen->rng, 100) < gen->p.writes ?
+	       'S' : 'L';
+}
+
+
+/*
+ * zipfRank - the rank drawn for a uniform u, by binary search of the cdf
+ */
+static uint64_t zipfRank(gen_t* gen, double u)
+{
+	uint64_t lo = 0, hi = gen->elems - 1;
+
+	while(lo < hi) {
+		uint64_t mid = lo + (hi - lo) / 2;
+		if(gen->cdf[mid] < u)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+
+int initGen(gen_t* gen, const gen_params_t* params)
+{
+	gen_params_t* p = &gen->p;
+
+	memset(gen, 0, sizeof(*gen));
+	*p = *params;
+
+	if(p->pattern < 0 || p->pattern >= GEN_PATTERNS || p->writes < 0 ||
+	   p->writes > 100 || p->nx < 0 || p->ny < 0 || p->nz < 0 || p->tile < 0)
+		return -1;
+
+	//defaults: a megabyte of 8 byte elements, or 64 byte list nodes
+	if(!p->base)
+		p->base = GEN_DEFAULT_BASE;
+	if(!p->elem)
+		p->elem = p->pattern == GEN_CHASE ? 64 : 8;
+	if(!p->stride)
+		p->stride = p->elem;
+	if(!p->footprint)
+		p->footprint = 1 << 20;
+	if(p->alpha == 0)
+		p->alpha = 1.0;
+	if(!p->nx)
+		p->nx = p->pattern == GEN_STENCIL3D ? 64 : 256;
+	if(!p->ny)
+		p->ny = p->nx;
+	if(!p->nz)
+		p->nz = p->nx;
+	if(!p->tile)
+		p->tile = 32;
+	if(!p->count)
+		p->count = bySweeps(p->pattern) ? 1 : 1000000;
+
+	gen->rng = p->seed * 0x9e3779b97f4a7c15ULL + 0x632be59bd9b4e5ffULL;
+	if(!gen->rng)
+		gen->rng = 1;
+	gen->elems = p->footprint / p->elem;
+	if(gen->elems == 0)
+		return -1;
+
+	switch(p->pattern) {
+	case GEN_ZIPF:
+		if(gen->elems > GEN_MAX_TABLE || p->alpha < 0)
+			return -1;
+		gen->cdf = malloc(gen->elems * sizeof(double));
+		if(!gen->cdf)
+			return -1;
+
+		double sum = 0;
+		for(uint64_t r = 0; r < gen->elems; r++)
+			gen->cdf[r] = sum += pow(r + 1, -p->alpha);
+		for(uint64_t r = 0; r < gen->elems; r++)
+			gen->cdf[r] /= sum;
+		break;
+
+	case GEN_CHASE:
+		if(gen->elems > GEN_MAX_TABLE)
+			return -1;
+		gen->next = malloc(gen->elems * sizeof(uint32_t));
+		if(!gen->next)
+			return -1;
+
+		//Sattolo's shuffle: a random permutation that is a single cycle
+		for(uint64_t n = 0; n < gen->elems; n++)
+			gen->next[n] = n;
+		for(uint64_t n = gen->elems - 1; n > 0; n--) {
+			uint64_t m = randomBelow(&gen->rng, n);
+			uint32_t tmp = gen->next[n];
+			gen->next[n] = gen->next[m];
+			gen->next[m] = tmp;
+		}
+		break;
+
+	case GEN_STENCIL2D:
+	case GEN_STENCIL3D:
+		if(p->nx < 3 || p->ny < 3 || (p->pattern == GEN_STENCIL3D && p->nz < 3))
+			return -1;
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+
+void freeGen(gen_t* gen)
+{
+	free(gen->cdf);
+	free(gen->next);
+}
+
+
+/* a * b, or UINT64_MAX if that overflows */
+static uint64_t mulCapped(uint64_t a, uint64_t b)
+{
+	uint64_t r;
+
+	return __builtin_mul_overflow(a, b, &r) ? UINT64_MAX : r;
+}
+
+uint64_t genLength(const gen_t* gen)
+{
+	const gen_params_t* p = &gen->p;
+	uint64_t w = p->nx - 2, h = p->ny - 2, d = p->nz - 2;
+
+	switch(p->pattern) {
+	case GEN_STENCIL2D:
+		return mulCapped(p->count, mulCapped(w * h, 6));
+	case GEN_STENCIL3D:
+		return mulCapped(p->count, mulCapped(mulCapped(w * h, d), 8));
+	case GEN_MATMUL:
+		//two loads and a modify per step, nx^3 steps
+		return mulCapped(p->count,
+		                 mulCapped((uint64_t)p->nx * p->nx, mulCapped(p->nx, 4)));
+	case GEN_HASH:
+		return mulCapped(p->count, HASH_MAX_PROBE + 1);
+	default:
+		return p->count;
+	}
+}
+
+
+static void emit(access_t* a, char op, mem_addr_t addr, unsigned int len)
+{
+	a->op = op;
+	a->addr = addr;
+	a->len = len;
+}
+
+
+/*
+ * stencilStep - loads of the neighbourhood of one interior point of A,
+ * then the store of the same point of B, which follows A in memory
+ */
+static int stencilStep(gen_t* gen, access_t* out)
+{
+	gen_params_t* p = &gen->p;
+	uint64_t w = p->nx - 2, h = p->ny - 2;
+	uint64_t d = p->pattern == GEN_STENCIL3D ? p->nz - 2 : 1;
+	uint64_t plane = (uint64_t)p->nx * p->ny;
+	mem_addr_t b = p->base + plane * (p->pattern == GEN_STENCIL3D ? p->nz : 1) * p->elem;
+	int n = 0;
+
+	if(gen->step == w * h * d)
+		return -1;
+
+	uint64_t x = gen->step % w + 1;
+	uint64_t y = gen->step / w % h + 1;
+	uint64_t z = gen->step / w / h + (p->pattern == GEN_STENCIL3D);
+	uint64_t at = z * plane + y * p->nx + x;
+
+	if(p->pattern == GEN_STENCIL3D)
+		emit(&out[n++], 'L', p->base + (at - plane) * p->elem, p->elem);
+	emit(&out[n++], 'L', p->base + (at - p->nx) * p->elem, p->elem);
+	emit(&out[n++], 'L', p->base + (at - 1) * p->elem, p->elem);
+	emit(&out[n++], 'L', p->base + at * p->elem, p->elem);
+	emit(&out[n++], 'L', p->base + (at + 1) * p->elem, p->elem);
+	emit(&out[n++], 'L', p->base + (at + p->nx) * p->elem, p->elem);
+	if(p->pattern == GEN_STENCIL3D)
+		emit(&out[n++], 'L', p->base + (at + plane) * p->elem, p->elem);
+	emit(&out[n++], 'S', b + at * p->elem, p->elem);
+	return n;
+}
+
+
+/*
+ * matmulStep - C[i][j] += A[i][k] * B[k][j] at the current position, then
+ * move on in the loop nest ii, jj, kk (blocks), i, j, k (within a block)
+ */
+static int matmulStep(gen_t* gen, access_t* out)
+{
+	gen_params_t* p = &gen->p;
+	int n = p->nx, t = p->tile;
+	uint64_t side = (uint64_t)n * n * p->elem;
+	mem_addr_t a = p->base, b = a + side, c = b + side;
+
+	if(gen->ii >= n)
+		return -1;
+
+	emit(&out[0], 'L', a + ((uint64_t)gen->i * n + gen->k) * p->elem, p->elem);
+	emit(&out[1], 'L', b + ((uint64_t)gen->k * n + gen->j) * p->elem, p->elem);
+	emit(&out[2], 'M', c + ((uint64_t)gen->i * n + gen->j) * p->elem, p->elem);
+
+	if(++gen->k < n && gen->k < gen->kk + t)
+		return 3;
+	gen->k = gen->kk;
+	if(++gen->j < n && gen->j < gen->jj + t)
+		return 3;
+	gen->j = gen->jj;
+	if(++gen->i < n && gen->i < gen->ii + t)
+		return 3;
+
+	//block done, on to the next one
+	if((gen->kk += t) >= n) {
+		gen->kk = 0;
+		if((gen->jj += t) >= n) {
+			gen->jj = 0;
+			gen->ii += t;
+		}
+	}
+	gen->i = gen->ii;
+	gen->j = gen->jj;
+	gen->k = gen->kk;
+	return 3;
+}
+
+
+/*
+ * hashStep - one lookup: a random key's home bucket, then as many of the
+ * following buckets as its (random) probe sequence is long; an insert
+ * writes the last one
+ */
+static int hashStep(gen_t* gen, access_t* out)
+{
+	gen_params_t* p = &gen->p;
+	uint64_t bucket = randomBelow(&gen->rng, gen->elems);
+	char op = randomOp(gen);
+	int n = 1;
+
+	while(n < HASH_MAX_PROBE && (nextRandom(&gen->rng) & 1))
+		n++;
+
+	for(int i = 0; i < n; i++) {
+		emit(&out[i], 'L', p->base + bucket * p->elem, p->elem);
+		bucket = bucket + 1 == gen->elems ? 0 : bucket + 1;
+	}
+	out[n - 1].op = op == 'S' ? 'M' : 'L';
+	return n;
+}
+
+
+/*
+ * genStep - the accesses of the next step of the current sweep, or -1 at
+ * the end of a sweep
+ */
+static int genStep(gen_t* gen, access_t* out)
+{
+	gen_params_t* p = &gen->p;
+
+	//the stencils and matmul end a sweep themselves
+	if(!bySweeps(p->pattern) && gen->step == p->count)
+		return -1;
+
+	switch(p->pattern) {
+	case GEN_STRIDE:
+		emit(out, 'L', p->base + gen->step * p->stride % p->footprint, p->elem);
+		return 1;
+	case GEN_UNIFORM:
+		emit(out, randomOp(gen), p->base + randomBelow(&gen->rng, gen->elems) * p->elem,
+		     p->elem);
+		return 1;
+	case GEN_ZIPF: {
+		double u = (nextRandom(&gen->rng) >> 11) * (1.0 / (1ULL << 53));
+		emit(out, randomOp(gen), p->base + zipfRank(gen, u) * p->elem, p->elem);
+		return 1;
+	}
+	case GEN_CHASE:
+		emit(out, 'L', p->base + gen->node * p->elem, p->elem);
+		gen->node = gen->next[gen->node];
+		return 1;
+	case GEN_STENCIL2D:
+	case GEN_STENCIL3D:
+		return stencilStep(gen, out);
+	case GEN_MATMUL:
+		return matmulStep(gen, out);
+	case GEN_HASH:
+		return hashStep(gen, out);
+	default:
+		return -1;
+	}
+}
+
+
+int genTrace(gen_t* gen, access_t* batch, int max)
+{
+	int n = 0;
+
+	while(!gen->done && n + GEN_MAX_STEP <= max) {
+		int got = genStep(gen, batch + n);
+
+		if(got < 0) {
+			//the patterns with several sweeps start over, the rest are done
+			gen->step = 0;
+			gen->ii = gen->jj = gen->kk = 0;
+			gen->i = gen->j = gen->k = 0;
+			if(!bySweeps(gen->p.pattern) || ++gen->sweep == gen->p.count)
+				gen->done = 1;
+			continue;
+		}
+		gen->step++;
+		n += got;
+	}
+
+	return n;
+}
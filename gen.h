@@ -0,0 +1,107 @@
+/*
+ * gen.h - Synthetic access streams
+ *
+ * A generator produces a deterministic stream of accesses following one
+ * of a few classic patterns, in the same batches of access_t a trace
+ * reader produces (see trace.h), so a stream can be written out as a trace
+ * or fed straight into a simulated cache:
+ *
+ *   stride     a sweep over the footprint, stride bytes at a time
+ *   uniform    uniformly random elements of the footprint
+ *   zipf       random elements, the k-th most popular with weight 1/k^alpha
+ *   chase      a linked list through the footprint, visited in random order
+ *   stencil2d  5-point stencil over an nx x ny grid, from A into B
+ *   stencil3d  7-point stencil over an nx x ny x nz grid, from A into B
+ *   matmul     C += A * B on nx x nx matrices, in tile x tile blocks
+ *   hash       lookups in an open addressing table filling the footprint
+ *
+ * The same parameters and seed always give the same stream.
+ *
+ * Files including this header must enable POSIX declarations (for example
+ * by defining _POSIX_C_SOURCE 200809L) before any system header.
+ */
+#ifndef GEN_H
+#define GEN_H
+
+#include <stdint.h>
+
+#include "cachesim.h"
+
+/* Most accesses a single step of any pattern makes; a batch passed to
+ * genTrace() must have room for at least this many */
+#define GEN_MAX_STEP 8
+
+typedef enum gen_pattern {
+	GEN_STRIDE = 0,
+	GEN_UNIFORM,
+	GEN_ZIPF,
+	GEN_CHASE,
+	GEN_STENCIL2D,
+	GEN_STENCIL3D,
+	GEN_MATMUL,
+	GEN_HASH,
+	GEN_PATTERNS
+} gen_pattern_t;
+
+/* Type: Generator parameters
+ *
+ * Not every field is used by every pattern; zero picks the default.
+ */
+typedef struct gen_params {
+	gen_pattern_t pattern;
+	mem_addr_t base;     // address of the first byte touched
+	uint64_t count;      // steps (accesses, lookups), or sweeps for the
+	                     // stencils and matmul
+	uint64_t footprint;  // bytes covered by stride/uniform/zipf/chase/hash
+	unsigned int elem;   // element (node, bucket) size, and access size
+	unsigned int stride; // bytes between stride accesses
+	double alpha;        // zipf exponent
+	int nx, ny, nz;      // grid (stencils) or matrix side (matmul, nx)
+	int tile;            // matmul block side
+	int writes;          // percent of random accesses that are stores
+	uint64_t seed;
+} gen_params_t;
+
+/* Type: Generator
+ *
+ * The state of one stream; only touched through the functions below.
+ */
+typedef struct gen {
+	gen_params_t p;
+	uint64_t rng;        // xorshift64* state
+	uint64_t step;       // steps made so far in this sweep
+	uint64_t sweep;
+	uint64_t elems;      // elements in the footprint
+	double* cdf;         // zipf: cumulative popularity of each rank
+	uint32_t* next;      // chase: successor of each node
+	uint64_t node;       // chase: current node
+	int i, j, k;         // matmul position
+	int ii, jj, kk;      // matmul block
+	int done;
+} gen_t;
+
+/* Name of a pattern, and the pattern of a name (-1 if unknown) */
+const char* genPatternName(gen_pattern_t pattern);
+int parseGenPattern(const char* name);
+
+/*
+ * Set up a generator, filling in defaults for unset parameters.  Returns
+ * -1 if the parameters make no sense for the pattern.
+ */
+int initGen(gen_t* gen, const gen_params_t* params);
+
+void freeGen(gen_t* gen);
+
+/*
+ * Most accesses the whole stream makes, a modify counting as a load and a
+ * store, or UINT64_MAX if that many can't be counted.
+ */
+uint64_t genLength(const gen_t* gen);
+
+/*
+ * Produce the next accesses of the stream into batch (max must be at least
+ * GEN_MAX_STEP); returns 0 at the end of the stream.
+ */
+int genTrace(gen_t* gen, access_t* batch, int max);
+
+#endif /* GEN_H */
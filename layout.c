@@ -0,0 +1,112 @@
+/*
+ * layout.c - Alternative memory layouts of recorded matrices, see layout.h
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+
+#include "layout.h"
+
+
+int parseLayout(layout_t* layout, const char* spec)
+{
+	char end;
+
+	memset(layout, 0, sizeof(*layout));
+
+	if(strcmp(spec, "row") == 0) {
+		layout->kind = LAYOUT_ROW;
+	} else if(strcmp(spec, "morton") == 0) {
+		layout->kind = LAYOUT_MORTON;
+	} else if(sscanf(spec, "padded:%d%c", &layout->pad, &end) == 1 && layout->pad >= 0) {
+		layout->kind = LAYOUT_PADDED;
+	} else if(sscanf(spec, "tiled:%dx%d%c", &layout->tw, &layout->th, &end) == 2 &&
+	          layout->tw > 0 && layout->th > 0) {
+		layout->kind = LAYOUT_TILED;
+	} else {
+		return -1;
+	}
+
+	snprintf(layout->name, sizeof(layout->name), "%s", spec);
+	return 0;
+}
+
+
+int addMatrix(layout_t* layout, const char* spec)
+{
+	matrix_t* m = &layout->matrices[layout->count];
+	char sep, end;
+	int n;
+
+	if(layout->count == MAX_MATRICES)
+		return -1;
+
+	m->elem = 4;
+	n = sscanf(spec, "%llx:%dx%d%c%d%c", &m->base, &m->cols, &m->rows, &sep,
+	           &m->elem, &end);
+	if((n != 3 && (n != 5 || sep != ':')) || m->rows < 1 || m->cols < 1 ||
+	   m->elem < 1)
+		return -1;
+
+	layout->count++;
+	return 0;
+}
+
+
+/*
+ * spreadBits - move bit i of x to bit 2i
+ */
+static uint64_t spreadBits(uint32_t v)
+{
+	uint64_t x = v;
+
+	x = (x | x << 16) & 0x0000ffff0000ffffULL;
+	x = (x | x << 8)  & 0x00ff00ff00ff00ffULL;
+	x = (x | x << 4)  & 0x0f0f0f0f0f0f0f0fULL;
+	x = (x | x << 2)  & 0x3333333333333333ULL;
+	x = (x | x << 1)  & 0x5555555555555555ULL;
+	return x;
+}
+
+
+mem_addr_t mapLayout(void* arg, mem_addr_t addr)
+{
+	layout_t* layout = arg;
+
+	if(layout->kind == LAYOUT_ROW)
+		return addr;
+
+	for(int i = 0; i < layout->count; i++) {
+		matrix_t* m = &layout->matrices[i];
+		mem_addr_t size = (mem_addr_t)m->rows * m->cols * m->elem;
+		uint64_t index, r, c, at;
+
+		if(addr - m->base >= size)
+			continue;
+
+		//element and byte within it
+		index = (addr - m->base) / m->elem;
+		r = index / m->cols;
+		c = index % m->cols;
+
+		switch(layout->kind) {
+		case LAYOUT_PADDED:
+			at = r * (m->cols + layout->pad) + c;
+			break;
+		case LAYOUT_TILED: {
+			uint64_t across = (m->cols + layout->tw - 1) / layout->tw;
+			uint64_t tile = r / layout->th * across + c / layout->tw;
+			at = tile * layout->tw * layout->th + r % layout->th * layout->tw +
+			     c % layout->tw;
+			break;
+		}
+		default:
+			at = spreadBits(r) << 1 | spreadBits(c);
+			break;
+		}
+
+		return m->base + at * m->elem + (addr - m->base) % m->elem;
+	}
+
+	return addr;
+}
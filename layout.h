@@ -0,0 +1,67 @@
+/*
+ * layout.h - Alternative memory layouts of recorded matrices
+ *
+ * A traced program keeps its matrices row-major.  To see what another
+ * layout would do to its misses, every access falling into a known matrix
+ * is moved to where the same element would live in that layout:
+ *
+ *   row            row-major, as recorded
+ *   padded:P       row-major with P unused elements after each row
+ *   tiled:WxH      W x H tiles, each stored row-major, tiles row-major
+ *   morton         Z-order: the bits of row and column interleaved
+ *
+ * A remapped matrix keeps its base address, so the padded, tiled and
+ * Morton layouts (which round the matrix up) may need more room than
+ * the recorded one; matrices should lie far enough apart for that.
+ * Accesses outside every matrix are left alone.
+ */
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include "cachesim.h"
+
+/* Most matrices one layout can rearrange */
+#define MAX_MATRICES 16
+
+typedef enum layout_kind {
+	LAYOUT_ROW = 0,
+	LAYOUT_PADDED,
+	LAYOUT_TILED,
+	LAYOUT_MORTON
+} layout_kind_t;
+
+/* A recorded matrix: rows x cols elements of elem bytes, row-major */
+typedef struct matrix {
+	mem_addr_t base;
+	int rows, cols;
+	int elem;
+} matrix_t;
+
+/* Type: Layout
+ *
+ * One layout applied to a set of matrices; an addr_map_t argument for
+ * mapLayout().
+ */
+typedef struct layout {
+	layout_kind_t kind;
+	int pad;           // padded: elements after each row
+	int tw, th;        // tiled: tile width and height
+	char name[32];
+	int count;
+	matrix_t matrices[MAX_MATRICES];
+} layout_t;
+
+/*
+ * Parse a layout ("row", "padded:8", "tiled:8x8" or "morton") into
+ * layout, without matrices.  Returns -1 if it isn't one.
+ */
+int parseLayout(layout_t* layout, const char* spec);
+
+/* Parse a matrix "base:MxN[:elem]" (M columns, N rows, elem bytes, 4 by
+ * default) and add it to layout; -1 if malformed or there is no room */
+int addMatrix(layout_t* layout, const char* spec);
+
+/* The address of addr in the layout (an addr_map_t) */
+mem_addr_t mapLayout(void* layout, mem_addr_t addr);
+
+#endif /* LAYOUT_H */
@@ -0,0 +1,186 @@
+/*
+ * paging.c - Virtual to physical translation of trace addresses, see
+ *     paging.h
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "paging.h"
+#include "random.h"
+
+/* Random frames tried before settling for one already in use */
+#define FRAME_TRIES 64
+/* Initial slots of a page table */
+#define TABLE_SLOTS 1024
+
+
+int parsePagePolicy(page_map_t* map, const char* spec, int page_bits,
+                    int phys_bits, uint64_t seed)
+{
+	int bits = HUGE_PAGE_BITS;
+	unsigned long long colors = 0;
+	char end;
+
+	memset(map, 0, sizeof(*map));
+	map->page_bits = page_bits;
+	map->seed = seed ? seed : 1;
+
+	if(strcmp(spec, "identity") == 0) {
+		map->policy = PAGE_IDENTITY;
+	} else if(strcmp(spec, "random") == 0) {
+		map->policy = PAGE_RANDOM;
+	} else if(sscanf(spec, "color:%llu%c", &colors, &end) == 1 && colors >= 1) {
+		map->policy = PAGE_COLOR;
+		map->colors = colors;
+	} else if(strcmp(spec, "huge") == 0 ||
+	          (sscanf(spec, "huge:%d%c", &bits, &end) == 1 && bits > page_bits &&
+	           bits <= 30)) {
+		map->policy = PAGE_HUGE;
+		map->page_bits = bits;
+	} else {
+		return -1;
+	}
+
+	if(phys_bits <= map->page_bits || phys_bits > 52)
+		return -1;
+	map->frames = 1ULL << (phys_bits - map->page_bits);
+	if(map->policy == PAGE_COLOR && map->colors > map->frames)
+		return -1;
+	snprintf(map->name, sizeof(map->name), "%s", spec);
+	return 0;
+}
+
+
+void freePageMap(page_map_t* map)
+{
+	free(map->vpns);
+	free(map->pfns);
+	free(map->used);
+	map->vpns = map->pfns = map->used = NULL;
+}
+
+
+/* slot - the first slot to probe for key in a table of cap slots */
+static inline size_t slot(mem_addr_t key, size_t cap)
+{
+	key *= 0x9e3779b97f4a7c15ULL;
+	return (key ^ key >> 29) & (cap - 1);
+}
+
+
+/*
+ * grow - double the tables (or make the first ones), rehashing what is
+ * in them; exits when out of memory, like initCache()
+ */
+static void grow(page_map_t* map)
+{
+	size_t cap = map->cap ? 2 * map->cap : TABLE_SLOTS;
+	mem_addr_t* vpns = calloc(cap, sizeof(mem_addr_t));
+	mem_addr_t* pfns = calloc(cap, sizeof(mem_addr_t));
+	mem_addr_t* used = calloc(cap, sizeof(mem_addr_t));
+
+	if(!vpns || !pfns || !used) {
+		fprintf(stderr, "out of memory for the page table\n");
+		exit(1);
+	}
+
+	for(size_t i = 0; i < map->cap; i++) {
+		if(map->vpns[i]) {
+			size_t k = slot(map->vpns[i], cap);
+			while(vpns[k])
+				k = (k + 1) & (cap - 1);
+			vpns[k] = map->vpns[i];
+			pfns[k] = map->pfns[i];
+		}
+		if(map->used[i]) {
+			size_t k = slot(map->used[i], cap);
+			while(used[k])
+				k = (k + 1) & (cap - 1);
+			used[k] = map->used[i];
+		}
+	}
+
+	freePageMap(map);
+	map->vpns = vpns;
+	map->pfns = pfns;
+	map->used = used;
+	map->cap = cap;
+}
+
+
+/*
+ * claimFrame - mark pfn as handed out; 0 if it already was
+ */
+static int claimFrame(page_map_t* map, mem_addr_t pfn)
+{
+	size_t k = slot(pfn + 1, map->cap);
+
+	while(map->used[k]) {
+		if(map->used[k] == pfn + 1)
+			return 0;
+		k = (k + 1) & (map->cap - 1);
+	}
+	map->used[k] = pfn + 1;
+	return 1;
+}
+
+
+/* A frame below n, taken from the top bits of the draw */
+static uint64_t randomFrame(page_map_t* map, uint64_t n)
+{
+	return (nextRandom(&map->seed) >> 11) % n;
+}
+
+
+/*
+ * newFrame - a frame for virtual page vpn under the map's policy
+ */
+static mem_addr_t newFrame(page_map_t* map, mem_addr_t vpn)
+{
+	mem_addr_t pfn = 0;
+
+	for(int tries = 0; tries < FRAME_TRIES; tries++) {
+		if(map->policy == PAGE_COLOR)
+			pfn = randomFrame(map, map->frames / map->colors) * map->colors +
+			      vpn % map->colors;
+		else
+			pfn = randomFrame(map, map->frames);
+		if(claimFrame(map, pfn))
+			break;
+	}
+	return pfn;
+}
+
+
+mem_addr_t translateAddress(void* arg, mem_addr_t addr)
+{
+	page_map_t* map = arg;
+	mem_addr_t vpn = addr >> map->page_bits;
+	mem_addr_t offset = addr & ((1ULL << map->page_bits) - 1);
+
+	if(map->policy == PAGE_IDENTITY)
+		return addr;
+
+	//consecutive accesses mostly stay on one page
+	if(map->pages && vpn == map->last_vpn)
+		return map->last_pfn << map->page_bits | offset;
+
+	if(2 * (map->pages + 1) > map->cap)
+		grow(map);
+
+	size_t k = slot(vpn + 1, map->cap);
+	while(map->vpns[k] && map->vpns[k] != vpn + 1)
+		k = (k + 1) & (map->cap - 1);
+
+	if(!map->vpns[k]) {
+		map->vpns[k] = vpn + 1;
+		map->pfns[k] = newFrame(map, vpn);
+		map->pages++;
+	}
+
+	map->last_vpn = vpn;
+	map->last_pfn = map->pfns[k];
+	return map->last_pfn << map->page_bits | offset;
+}
@@ -0,0 +1,72 @@
+/*
+ * paging.h - Virtual to physical translation of trace addresses
+ *
+ * A trace records virtual addresses, but caches below the first level are
+ * indexed by physical address: where the operating system puts each page
+ * decides which pages compete for the same sets.  A page map translates
+ * every access before it reaches the cache, allocating a frame the first
+ * time a page is touched, under one of these policies:
+ *
+ *   identity       physical = virtual, as csim assumes
+ *   random         any free frame, at random
+ *   color:N        a random free frame of the page's own color (page
+ *                  number modulo N), as an OS doing page coloring would
+ *   huge[:bits]    random frames of 2^bits bytes (default 21, 2MB pages)
+ *
+ * Frames are drawn from a physical memory of 2^phys_bits bytes and not
+ * handed out twice, unless it is nearly full.  The policies are addr_map_t
+ * functions, so several can be compared on one trace in lockstep (see
+ * simulateLockstep()).
+ */
+#ifndef PAGING_H
+#define PAGING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cachesim.h"
+
+#define PAGE_BITS 12
+#define HUGE_PAGE_BITS 21
+#define PHYS_BITS 34
+
+typedef enum page_policy {
+	PAGE_IDENTITY = 0,
+	PAGE_RANDOM,
+	PAGE_COLOR,
+	PAGE_HUGE
+} page_policy_t;
+
+/* Type: Page map
+ *
+ * One policy's page table; an addr_map_t argument for translateAddress().
+ */
+typedef struct page_map {
+	page_policy_t policy;
+	int page_bits;
+	uint64_t colors;     // color: number of colors
+	uint64_t frames;     // frames in physical memory
+	char name[32];
+	uint64_t seed;
+	size_t pages;        // pages mapped so far
+	size_t cap;          // slots in each table below, a power of two
+	mem_addr_t* vpns;    // page table: virtual page + 1 (0: free slot)
+	mem_addr_t* pfns;    // and the frame of each
+	mem_addr_t* used;    // set of frames handed out, + 1 (0: free slot)
+	mem_addr_t last_vpn, last_pfn;
+} page_map_t;
+
+/*
+ * Parse a policy ("identity", "random", "color:N" or "huge[:bits]") into
+ * map, for pages of 2^page_bits bytes (unless huge) in a physical memory
+ * of 2^phys_bits bytes.  Returns -1 if it isn't one.
+ */
+int parsePagePolicy(page_map_t* map, const char* spec, int page_bits,
+                    int phys_bits, uint64_t seed);
+
+void freePageMap(page_map_t* map);
+
+/* The physical address of addr, mapping its page first if need be */
+mem_addr_t translateAddress(void* map, mem_addr_t addr);
+
+#endif /* PAGING_H */
@@ -0,0 +1,499 @@
+/*
+ * profile.c - Statistical profiles of traces and proxy traces cloned from
+ *     them, see profile.h
+ *
+ * Stack distances are found in O(log n) per access: every line has a 1 at
+ * the time of its latest access in a Fenwick tree over time, so the
+ * number of lines touched since an earlier time is a range sum, and the
+ * line at a given distance is found by a rank search.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "profile.h"
+#include "random.h"
+
+#define PROFILE_MAGIC "csim-profile"
+
+/* Smallest line table, in entries */
+#define MAP_MIN 1024
+
+
+/*
+ * Stack distance buckets
+ */
+static int bucketOf(uint64_t d)
+{
+	if(d < PROFILE_EXACT)
+		return d;
+
+	int k = 63 - __builtin_clzll(d);
+	return PROFILE_EXACT + (k - 6) * PROFILE_SUB + ((d >> (k - 3)) & (PROFILE_SUB - 1));
+}
+
+/* Smallest distance in bucket i */
+static uint64_t bucketLow(int i)
+{
+	if(i < PROFILE_EXACT)
+		return i;
+
+	int k = (i - PROFILE_EXACT) / PROFILE_SUB + 6;
+	uint64_t sub = (i - PROFILE_EXACT) % PROFILE_SUB;
+	return (1ULL << k) + (sub << (k - 3));
+}
+
+/* Number of distances in bucket i */
+static uint64_t bucketWidth(int i)
+{
+	if(i < PROFILE_EXACT)
+		return 1;
+	return 1ULL << ((i - PROFILE_EXACT) / PROFILE_SUB + 3);
+}
+
+
+/*
+ * Fenwick tree over times 1..n
+ */
+typedef struct fenwick {
+	size_t n;
+	uint32_t* tree;
+} fenwick_t;
+
+static int initFenwick(fenwick_t* f, size_t n)
+{
+	f->n = n;
+	f->tree = calloc(n + 1, sizeof(uint32_t));
+	return f->tree ? 0 : -1;
+}
+
+static void addFenwick(fenwick_t* f, size_t i, int v)
+{
+	for(; i <= f->n; i += i & -i)
+		f->tree[i] += v;
+}
+
+static uint64_t sumFenwick(fenwick_t* f, size_t i)
+{
+	uint64_t sum = 0;
+
+	for(; i > 0; i -= i & -i)
+		sum += f->tree[i];
+	return sum;
+}
+
+/* Smallest time whose prefix sum is rank */
+static size_t rankFenwick(fenwick_t* f, uint64_t rank)
+{
+	size_t at = 0;
+	size_t step = 1;
+
+	while(step * 2 <= f->n)
+		step *= 2;
+	for(; step; step /= 2) {
+		if(at + step <= f->n && f->tree[at + step] < rank) {
+			at += step;
+			rank -= f->tree[at];
+		}
+	}
+	return at + 1;
+}
+
+
+/*
+ * Line table: line -> time of its latest access, open addressing
+ */
+typedef struct line_map {
+	size_t size;     // entries, a power of two
+	size_t used;
+	uint64_t* keys;  // line + 1, 0 for an empty entry
+	size_t* times;
+} line_map_t;
+
+static int initMap(line_map_t* map, size_t size)
+{
+	map->size = size;
+	map->used = 0;
+	map->keys = calloc(size, sizeof(uint64_t));
+	map->times = malloc(size * sizeof(size_t));
+	return map->keys && map->times ? 0 : -1;
+}
+
+static void freeMap(line_map_t* map)
+{
+	free(map->keys);
+	free(map->times);
+}
+
+static size_t slotOf(line_map_t* map, uint64_t line)
+{
+	size_t i = (line * 0x9e3779b97f4a7c15ULL) >> 20 & (map->size - 1);
+
+	while(map->keys[i] && map->keys[i] != line + 1)
+		i = (i + 1) & (map->size - 1);
+	return i;
+}
+
+/* Time of the line's latest access, 0 if never */
+static size_t lookupLine(line_map_t* map, uint64_t line)
+{
+	size_t i = slotOf(map, line);
+	return map->keys[i] ? map->times[i] : 0;
+}
+
+static int storeLine(line_map_t* map, uint64_t line, size_t time)
+{
+	size_t i = slotOf(map, line);
+
+	if(!map->keys[i]) {
+		//keep the table at most half full
+		if(2 * (map->used + 1) > map->size) {
+			line_map_t bigger;
+
+			if(initMap(&bigger, 2 * map->size) != 0) {
+				freeMap(&bigger);
+				return -1;
+			}
+			for(size_t j = 0; j < map->size; j++) {
+				if(map->keys[j]) {
+					size_t k = slotOf(&bigger, map->keys[j] - 1);
+					bigger.keys[k] = map->keys[j];
+					bigger.times[k] = map->times[j];
+				}
+			}
+			bigger.used = map->used;
+			freeMap(map);
+			*map = bigger;
+			i = slotOf(map, line);
+		}
+		map->keys[i] = line + 1;
+		map->used++;
+	}
+	map->times[i] = time;
+	return 0;
+}
+
+
+/*
+ * countStride - Misra-Gries: keep the most frequent strides of a region
+ * in PROFILE_STRIDES counters
+ */
+static void countStride(region_profile_t* r, int64_t stride)
+{
+	int i;
+
+	for(i = 0; i < r->strides; i++) {
+		if(r->stride[i] == stride) {
+			r->stride_count[i]++;
+			return;
+		}
+	}
+	if(r->strides < PROFILE_STRIDES) {
+		r->stride[r->strides] = stride;
+		r->stride_count[r->strides++] = 1;
+		return;
+	}
+
+	//no room: every counter loses one, the ones at zero make room
+	for(i = 0; i < r->strides; ) {
+		if(--r->stride_count[i] == 0) {
+			r->stride[i] = r->stride[--r->strides];
+			r->stride_count[i] = r->stride_count[r->strides];
+		} else {
+			i++;
+		}
+	}
+}
+
+
+int profileTrace(profile_t* profile, const access_t* trace, size_t n, int b,
+                 mem_addr_t gap)
+{
+	region_t ranges[MAX_REGIONS];
+	mem_addr_t last[MAX_REGIONS];
+	fenwick_t f;
+	line_map_t map;
+	int err = 0;
+
+	memset(profile, 0, sizeof(*profile));
+	profile->b = b;
+
+	profile->region_count = detectRegions(trace, n, gap, ranges, MAX_REGIONS);
+	if(profile->region_count < 0 || initFenwick(&f, n) != 0 ||
+	   initMap(&map, MAP_MIN) != 0)
+		return -1;
+	for(int r = 0; r < profile->region_count; r++)
+		profile->regions[r].range = ranges[r];
+
+	for(size_t t = 1; t <= n && !err; t++) {
+		const access_t* a = &trace[t-1];
+		uint64_t line = a->addr >> b;
+		size_t seen = lookupLine(&map, line);
+
+		profile->accesses++;
+		profile->bytes += a->len;
+		profile->ops[a->op == 'S' ? 1 : a->op == 'M' ? 2 : 0]++;
+
+		if(seen) {
+			profile->distance[bucketOf(sumFenwick(&f, t - 1) - sumFenwick(&f, seen))]++;
+			addFenwick(&f, seen, -1);
+		} else {
+			profile->footprint++;
+		}
+		addFenwick(&f, t, 1);
+		err = storeLine(&map, line, t);
+
+		int r = findRegion(ranges, profile->region_count, a->addr);
+		if(r >= 0) {
+			if(profile->regions[r].accesses++)
+				countStride(&profile->regions[r], (int64_t)(a->addr - last[r]));
+			last[r] = a->addr;
+		}
+	}
+
+	free(f.tree);
+	freeMap(&map);
+	return err;
+}
+
+
+void missRatioCurve(const profile_t* profile, double mrc[MRC_POINTS])
+{
+	for(int k = 0; k < MRC_POINTS; k++) {
+		uint64_t misses = profile->footprint;
+
+		//a cache of C lines hits exactly the distances below C
+		for(int i = 0; i < PROFILE_BUCKETS; i++) {
+			if(bucketLow(i) >= 1ULL << k)
+				misses += profile->distance[i];
+		}
+		mrc[k] = profile->accesses ? (double)misses / profile->accesses : 0;
+	}
+}
+
+
+int saveProfile(const profile_t* profile, const char* path)
+{
+	FILE* fp = fopen(path, "w");
+
+	if(!fp)
+		return -1;
+
+	fprintf(fp, "%s %d\n", PROFILE_MAGIC, PROFILE_VERSION);
+	fprintf(fp, "b %d\n", profile->b);
+	fprintf(fp, "accesses %llu\n", (unsigned long long)profile->accesses);
+	fprintf(fp, "bytes %llu\n", (unsigned long long)profile->bytes);
+	fprintf(fp, "ops %llu %llu %llu\n", (unsigned long long)profile->ops[0],
+	        (unsigned long long)profile->ops[1], (unsigned long long)profile->ops[2]);
+	fprintf(fp, "footprint %llu\n", (unsigned long long)profile->footprint);
+	for(int i = 0; i < PROFILE_BUCKETS; i++) {
+		if(profile->distance[i])
+			fprintf(fp, "distance %d %llu\n", i,
+			        (unsigned long long)profile->distance[i]);
+	}
+	for(int r = 0; r < profile->region_count; r++) {
+		const region_profile_t* p = &profile->regions[r];
+
+		fprintf(fp, "region %llx %llx %llu\n", p->range.lo, p->range.hi,
+		        (unsigned long long)p->accesses);
+		for(int i = 0; i < p->strides; i++)
+			fprintf(fp, "stride %lld %llu\n", (long long)p->stride[i],
+			        (unsigned long long)p->stride_count[i]);
+	}
+
+	if(ferror(fp)) {
+		fclose(fp);
+		return -1;
+	}
+	return fclose(fp);
+}
+
+
+int loadProfile(profile_t* profile, const char* path)
+{
+	FILE* fp = fopen(path, "r");
+	char line[256], magic[32];
+	unsigned long long x, y, z;
+	long long stride;
+	int version, i, ok = 1;
+
+	if(!fp)
+		return -1;
+	memset(profile, 0, sizeof(*profile));
+
+	if(!fgets(line, sizeof(line), fp) ||
+	   sscanf(line, "%31s %d", magic, &version) != 2 ||
+	   strcmp(magic, PROFILE_MAGIC) != 0 || version != PROFILE_VERSION)
+		ok = 0;
+
+	while(ok && fgets(line, sizeof(line), fp)) {
+		region_profile_t* p = &profile->regions[profile->region_count - 1];
+
+		if(sscanf(line, "b %d", &profile->b) == 1) {
+			ok = profile->b >= 0 && profile->b < 64;
+		} else if(sscanf(line, "accesses %llu", &x) == 1) {
+			profile->accesses = x;
+		} else if(sscanf(line, "bytes %llu", &x) == 1) {
+			profile->bytes = x;
+		} else if(sscanf(line, "ops %llu %llu %llu", &x, &y, &z) == 3) {
+			profile->ops[0] = x;
+			profile->ops[1] = y;
+			profile->ops[2] = z;
+		} else if(sscanf(line, "footprint %llu", &x) == 1) {
+			profile->footprint = x;
+		} else if(sscanf(line, "distance %d %llu", &i, &x) == 2) {
+			ok = i >= 0 && i < PROFILE_BUCKETS;
+			if(ok)
+				profile->distance[i] = x;
+		} else if(sscanf(line, "region %llx %llx %llu", &x, &y, &z) == 3) {
+			ok = profile->region_count < MAX_REGIONS;
+			if(ok) {
+				p = &profile->regions[profile->region_count++];
+				p->range.lo = x;
+				p->range.hi = y;
+				p->accesses = z;
+			}
+		} else if(sscanf(line, "stride %lld %llu", &stride, &x) == 2) {
+			ok = profile->region_count > 0 && p->strides < PROFILE_STRIDES;
+			if(ok) {
+				p->stride[p->strides] = stride;
+				p->stride_count[p->strides++] = x;
+			}
+		} else {
+			ok = 0;
+		}
+	}
+
+	fclose(fp);
+	if(!ok) {
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+
+/*
+ * Sampling
+ */
+/* Index i drawn with probability weight[i] / total */
+static int pickWeighted(uint64_t* state, const uint64_t* weight, int n,
+                        uint64_t total)
+{
+	uint64_t u = randomBelow(state, total);
+
+	for(int i = 0; i < n; i++) {
+		if(u < weight[i])
+			return i;
+		u -= weight[i];
+	}
+	return n - 1;
+}
+
+
+access_t* cloneTrace(const profile_t* profile, size_t length, uint64_t seed)
+{
+	access_t* trace = malloc(length * sizeof(access_t));
+	uint64_t* times = malloc((length + 1) * sizeof(uint64_t));
+	mem_addr_t cursor[MAX_REGIONS];
+	uint64_t region_weight[MAX_REGIONS], region_total = 0;
+	uint64_t stride_total[MAX_REGIONS];
+	uint64_t state = seed * 0x9e3779b97f4a7c15ULL + 1;
+	uint64_t reuses = 0, live = 0;
+	mem_addr_t B = 1ULL << profile->b;
+	unsigned int len = profile->accesses ? profile->bytes / profile->accesses : 1;
+	fenwick_t f = { 0, NULL };
+	line_map_t map = { 0, 0, NULL, NULL };
+
+	if(!trace || !times || initFenwick(&f, length) != 0 || initMap(&map, MAP_MIN) != 0)
+		goto fail;
+
+	if(len < 1)
+		len = 1;
+	if(len > B)
+		len = B;
+	for(int i = 0; i < PROFILE_BUCKETS; i++)
+		reuses += profile->distance[i];
+	for(int r = 0; r < profile->region_count; r++) {
+		const region_profile_t* p = &profile->regions[r];
+
+		cursor[r] = p->range.lo;
+		region_weight[r] = p->accesses;
+		region_total += p->accesses;
+		stride_total[r] = 0;
+		for(int i = 0; i < p->strides; i++)
+			stride_total[r] += p->stride_count[i];
+	}
+	if(!state)
+		state = 1;
+
+	for(size_t t = 1; t <= length; t++) {
+		access_t* a = &trace[t-1];
+		uint64_t line;
+		uint64_t u = randomBelow(&state, reuses + profile->footprint);
+
+		a->op = "LSM"[pickWeighted(&state, profile->ops, 3, profile->accesses)];
+		a->len = len;
+
+		//a reuse at a distance drawn from the profile, while there are that
+		//many lines to go back over
+		if(u < reuses) {
+			int i = pickWeighted(&state, profile->distance, PROFILE_BUCKETS, reuses);
+			uint64_t d = bucketLow(i) + randomBelow(&state, bucketWidth(i));
+
+			if(d < live) {
+				size_t at = rankFenwick(&f, live - d);
+
+				line = times[at];
+				addFenwick(&f, at, -1);
+				addFenwick(&f, t, 1);
+				times[t] = line;
+				if(storeLine(&map, line, t) != 0)
+					goto fail;
+				a->addr = line << profile->b;
+				continue;
+			}
+		}
+
+		//otherwise a line not touched before, a stride on from the last new
+		//line of a region
+		if(region_total) {
+			int r = pickWeighted(&state, region_weight, profile->region_count,
+			                     region_total);
+			const region_profile_t* p = &profile->regions[r];
+			int64_t stride = B;
+
+			if(p->strides)
+				stride = p->stride[pickWeighted(&state, p->stride_count, p->strides,
+				                                stride_total[r])];
+			line = (cursor[r] + stride) >> profile->b;
+			while(lookupLine(&map, line))
+				line += stride < 0 ? -1 : 1;
+			cursor[r] = line << profile->b;
+		} else {
+			line = live;
+		}
+
+		addFenwick(&f, t, 1);
+		times[t] = line;
+		if(storeLine(&map, line, t) != 0)
+			goto fail;
+		live++;
+		a->addr = line << profile->b;
+	}
+
+	free(times);
+	free(f.tree);
+	freeMap(&map);
+	return trace;
+
+fail:
+	free(trace);
+	free(times);
+	free(f.tree);
+	freeMap(&map);
+	errno = ENOMEM;
+	return NULL;
+}
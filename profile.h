@@ -0,0 +1,90 @@
+/*
+ * profile.h - Statistical profiles of traces, and proxy traces cloned
+ *     from them
+ *
+ * A profile keeps what decides how a trace behaves in LRU caches, without
+ * the trace itself:
+ *
+ *   - the stack (reuse) distance of every access, in cache lines: how many
+ *     other lines were touched since its line was last touched, kept
+ *     exactly up to PROFILE_EXACT and in PROFILE_SUB buckets per power of
+ *     two above that; first touches are counted apart as cold;
+ *   - the mix of loads, stores and modifies, and the mean access size;
+ *   - the footprint, in distinct lines;
+ *   - per address region (see region.h), its share of the accesses and its
+ *     most frequent strides between consecutive accesses.
+ *
+ * cloneTrace() generates a proxy of any length that draws its stack
+ * distances from the profile and lays out the lines it touches for the
+ * first time with the regions' strides.  As long as the proxy is long
+ * enough to reuse lines at a distance, its miss ratio curve (the miss
+ * ratio of a fully associative LRU cache of each size, see
+ * missRatioCurve()) follows the original's.
+ *
+ * Profiles are saved as short text files.
+ */
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cachesim.h"
+#include "region.h"
+
+#define PROFILE_VERSION 1
+
+/* Stack distance buckets: exact below PROFILE_EXACT, then PROFILE_SUB
+ * per power of two up to 2^63 */
+#define PROFILE_EXACT 64
+#define PROFILE_SUB 8
+#define PROFILE_BUCKETS (PROFILE_EXACT + PROFILE_SUB * 58)
+
+/* Strides remembered per region */
+#define PROFILE_STRIDES 8
+
+/* Points of a miss ratio curve: caches of 1, 2, 4, ... 2^(n-1) lines */
+#define MRC_POINTS 24
+
+typedef struct region_profile {
+	region_t range;
+	uint64_t accesses;
+	int strides;                              // used entries below
+	int64_t stride[PROFILE_STRIDES];          // bytes
+	uint64_t stride_count[PROFILE_STRIDES];
+} region_profile_t;
+
+typedef struct profile {
+	int b;                 // line size is 2^b
+	uint64_t accesses;
+	uint64_t bytes;        // sum of access sizes
+	uint64_t ops[3];       // loads, stores, modifies
+	uint64_t footprint;    // distinct lines, also the cold accesses
+	uint64_t distance[PROFILE_BUCKETS];
+	int region_count;
+	region_profile_t regions[MAX_REGIONS];
+} profile_t;
+
+/*
+ * Profile n accesses with lines of 2^b bytes, splitting regions where
+ * addresses are more than gap apart.  Returns -1 if out of memory.
+ */
+int profileTrace(profile_t* profile, const access_t* trace, size_t n, int b,
+                 mem_addr_t gap);
+
+/* Save a profile to a file, or read one back; -1 (errno set) on failure,
+ * EINVAL for a file that isn't a profile */
+int saveProfile(const profile_t* profile, const char* path);
+int loadProfile(profile_t* profile, const char* path);
+
+/*
+ * Generate a proxy trace of length accesses from a profile, reproducibly
+ * for a seed.  Returns NULL if out of memory.
+ */
+access_t* cloneTrace(const profile_t* profile, size_t length, uint64_t seed);
+
+/* The miss ratio of fully associative LRU caches of 2^k lines, for k
+ * below MRC_POINTS */
+void missRatioCurve(const profile_t* profile, double mrc[MRC_POINTS]);
+
+#endif /* PROFILE_H */
@@ -0,0 +1,28 @@
+/*
+ * random.h - The pseudo-random numbers of the simulator and its tools
+ *
+ * xorshift64*: small, fast and good enough for picking addresses,
+ * placements and treap priorities, and the same sequence for the same
+ * seed on every machine, so that every run can be reproduced.  The state
+ * must not be 0.
+ */
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+static inline uint64_t nextRandom(uint64_t* state)
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 0x2545f4914f6cdd1dULL;
+}
+
+/* Uniform in [0, n), 0 if n is */
+static inline uint64_t randomBelow(uint64_t* state, uint64_t n)
+{
+	return n ? nextRandom(state) % n : 0;
+}
+
+#endif /* RANDOM_H */
@@ -0,0 +1,258 @@
+/*
+ * region.c - Address regions of a trace, see region.h
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "region.h"
+
+
+int parseRegion(region_t* region, const char* spec)
+{
+	if(sscanf(spec, "%llx-%llx", &region->lo, &region->hi) != 2 ||
+	   region->hi <= region->lo)
+		return -1;
+	return 0;
+}
+
+
+static int byAddress(const void* x, const void* y)
+{
+	mem_addr_t a = *(const mem_addr_t*)x;
+	mem_addr_t b = *(const mem_addr_t*)y;
+
+	return a < b ? -1 : a > b;
+}
+
+/* region_t starts with lo, so regions sort by address as well */
+int sortRegions(region_t* regions, int count)
+{
+	qsort(regions, count, sizeof(region_t), byAddress);
+	for(int i = 1; i < count; i++) {
+		if(regions[i].lo < regions[i-1].hi)
+			return -1;
+	}
+	return 0;
+}
+
+
+int detectRegions(const access_t* accesses, size_t n, mem_addr_t gap,
+                  region_t* regions, int max)
+{
+	mem_addr_t* addrs = malloc(n * sizeof(mem_addr_t));
+	int count = 0;
+
+	if(!addrs)
+		return -1;
+	if(n == 0) {
+		free(addrs);
+		return 0;
+	}
+
+	for(size_t i = 0; i < n; i++)
+		addrs[i] = accesses[i].addr;
+	qsort(addrs, n, sizeof(mem_addr_t), byAddress);
+
+	//one cluster per run of addresses less than gap apart; an access's
+	//size is ignored except for the last byte of a cluster
+	regions[0].lo = addrs[0];
+	regions[0].hi = addrs[0] + 1;
+	count = 1;
+
+	for(size_t i = 1; i < n; i++) {
+		region_t* last = &regions[count-1];
+
+		if(addrs[i] - (last->hi - 1) <= gap) {
+			last->hi = addrs[i] + 1;
+			continue;
+		}
+
+		//out of room: merge the two neighbours that are closest together
+		if(count == max) {
+			int closest = 1;
+			for(int r = 2; r < count; r++) {
+				if(regions[r].lo - regions[r-1].hi <
+				   regions[closest].lo - regions[closest-1].hi)
+					closest = r;
+			}
+			if(addrs[i] - last->hi < regions[closest].lo - regions[closest-1].hi) {
+				last->hi = addrs[i] + 1;
+				continue;
+			}
+			regions[closest-1].hi = regions[closest].hi;
+			for(int r = closest; r < count - 1; r++)
+				regions[r] = regions[r+1];
+			count--;
+		}
+
+		regions[count].lo = addrs[i];
+		regions[count].hi = addrs[i] + 1;
+		count++;
+	}
+
+	//take in the whole of the accesses at the ends of each region
+	for(size_t i = 0; i < n; i++) {
+		mem_addr_t end = accesses[i].addr + (accesses[i].len ? accesses[i].len : 1);
+		int r = findRegion(regions, count, accesses[i].addr);
+
+		if(r >= 0 && end > regions[r].hi &&
+		   (r == count - 1 || end <= regions[r+1].lo))
+			regions[r].hi = end;
+	}
+
+	free(addrs);
+	return count;
+}
+
+
+int traceRegions(region_t* regions, int count, const access_t* accesses,
+                 size_t n, mem_addr_t gap)
+{
+	if(count > 0) {
+		if(sortRegions(regions, count) != 0) {
+			errno = EINVAL;
+			return -1;
+		}
+		return count;
+	}
+
+	count = detectRegions(accesses, n, gap, regions, MAX_REGIONS);
+	if(count < 0)
+		errno = ENOMEM;
+	return count;
+}
+
+
+int findRegion(const region_t* regions, int count, mem_addr_t addr)
+{
+	int lo = 0, hi = count - 1;
+
+	while(lo <= hi) {
+		int mid = (lo + hi) / 2;
+
+		if(addr < regions[mid].lo)
+			hi = mid - 1;
+		else if(addr >= regions[mid].hi)
+			lo = mid + 1;
+		else
+			return mid;
+	}
+	return -1;
+}
+
+
+mem_addr_t shiftRegions(void* arg, mem_addr_t addr)
+{
+	region_shift_t* shift = arg;
+	int r = findRegion(shift->regions, shift->count, addr);
+
+	return r < 0 ? addr : addr + shift->offsets[r];
+}
+
+
+int shiftOverlaps(const region_shift_t* shift)
+{
+	for(int i = 0; i < shift->count; i++) {
+		mem_addr_t lo = shift->regions[i].lo + shift->offsets[i];
+		mem_addr_t hi = shift->regions[i].hi + shift->offsets[i];
+
+		for(int j = i + 1; j < shift->count; j++) {
+			if(shift->regions[j].lo + shift->offsets[j] < hi &&
+			   lo < shift->regions[j].hi + shift->offsets[j])
+				return 1;
+		}
+	}
+	return 0;
+}
+
+
+void initRegionTable(region_table_t* table, int bits)
+{
+	memset(table, 0, sizeof(*table));
+	table->bits = bits;
+}
+
+
+int addNamedRegion(region_table_t* table, const char* spec)
+{
+	const char* eq = strchr(spec, '=');
+	region_t range;
+
+	if(!eq || eq == spec || eq - spec >= REGION_NAME ||
+	   parseRegion(&range, eq + 1) != 0 || table->count == MAX_REGIONS)
+		return -1;
+	for(int i = 0; i < table->count; i++) {
+		if(range.lo < table->ranges[i].hi && table->ranges[i].lo < range.hi)
+			return -1;
+	}
+
+	table->bits = 0;
+	table->ranges[table->count] = range;
+	memcpy(table->names[table->count], spec, eq - spec);
+	table->names[table->count][eq - spec] = '\0';
+	table->count++;
+	return 0;
+}
+
+
+/*
+ * guessName - what lives at addr in a typical x86-64 Linux process: the
+ * program image and its brk heap at the bottom, PIE images and their heap
+ * around 0x55..., shared mappings up to the stack at the top; Valgrind
+ * puts its client's stack just below 0x800000000
+ */
+static const char* guessName(mem_addr_t addr)
+{
+	if(addr >= 0x7ff000000000ULL)
+		return "stack";
+	if(addr >= 0x7f0000000000ULL)
+		return "mmap";
+	if(addr >= 0x550000000000ULL && addr < 0x570000000000ULL)
+		return "globals";
+	if(addr >= 0x7f0000000ULL && addr < 0x800000000ULL)
+		return "stack";
+	if(addr < 0x100000000ULL)
+		return "globals";
+	return "heap";
+}
+
+
+int isAutoRegion(const char* name, size_t len)
+{
+	static const char* names[] = { "stack", "heap", "globals", "mmap" };
+
+	for(int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+		if(strlen(names[i]) == len && strncmp(names[i], name, len) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+
+int classifyAddress(region_table_t* table, mem_addr_t addr)
+{
+	region_t* last = &table->ranges[table->last];
+
+	//consecutive accesses mostly stay in one region
+	if(table->count && addr - last->lo < last->hi - last->lo)
+		return table->last;
+
+	for(int i = 0; i < table->count; i++) {
+		if(addr - table->ranges[i].lo < table->ranges[i].hi - table->ranges[i].lo)
+			return table->last = i;
+	}
+
+	if(!table->bits || table->count == MAX_REGIONS)
+		return -1;
+
+	//a new block of the address space, named after its first address (a
+	//block can be wider than the range guessName() tells apart)
+	region_t* r = &table->ranges[table->count];
+	r->lo = addr >> table->bits << table->bits;
+	r->hi = r->lo + (1ULL << table->bits);
+	snprintf(table->names[table->count], REGION_NAME, "%s", guessName(addr));
+	return table->last = table->count++;
+}
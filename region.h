@@ -0,0 +1,114 @@
+/*
+ * region.h - Address regions of a trace
+ *
+ * A region is a contiguous range of addresses, typically one array or
+ * heap object, the stack, or a program's globals.  Regions are given
+ * explicitly ("lo-hi", hex, hi exclusive) or found by clustering the
+ * addresses a trace touches: whenever two consecutive touched addresses
+ * are more than a gap apart, a new region starts.
+ *
+ * Region lists are kept sorted by address and non-overlapping, so an
+ * address is looked up by binary search.
+ *
+ * A region table classifies addresses into named regions (stack, heap,
+ * globals, mmap...) for per-region statistics, either by explicit
+ * "name=lo-hi" ranges or, without any, by the top address bits: every
+ * aligned 2^bits block of the address space touched becomes a region,
+ * named after where the usual x86-64 Linux (or Valgrind) layout puts
+ * such addresses.
+ */
+#ifndef REGION_H
+#define REGION_H
+
+#include <stddef.h>
+
+#include "cachesim.h"
+
+/* Most regions of one trace */
+#define MAX_REGIONS 64
+/* Default distance that separates found regions */
+#define REGION_GAP 65536
+
+typedef struct region {
+	mem_addr_t lo;
+	mem_addr_t hi;  // first address past the region
+} region_t;
+
+/* Parse "lo-hi"; -1 if malformed or empty */
+int parseRegion(region_t* region, const char* spec);
+
+/*
+ * Sort count regions and check that they don't overlap; -1 if they do.
+ */
+int sortRegions(region_t* regions, int count);
+
+/*
+ * Cluster the addresses of n accesses into at most max regions, splitting
+ * wherever consecutive addresses are more than gap apart (and merging the
+ * closest clusters if there would be more than max).  Returns the number
+ * of regions, or -1 if out of memory.
+ */
+int detectRegions(const access_t* accesses, size_t n, mem_addr_t gap,
+                  region_t* regions, int max);
+
+/*
+ * The regions of a trace: the count given (say with -R), sorted and
+ * checked, or if none were given, those detectRegions() finds with the
+ * given gap.  Returns the number of regions, or -1 with errno set to
+ * EINVAL if the given ones overlap or ENOMEM if out of memory.
+ */
+int traceRegions(region_t* regions, int count, const access_t* accesses,
+                 size_t n, mem_addr_t gap);
+
+/* Index of the region holding addr, or -1 */
+int findRegion(const region_t* regions, int count, mem_addr_t addr);
+
+/* Type: Region shift
+ *
+ * Moves every region by its own offset; an addr_map_t argument for
+ * shiftRegions().  Addresses outside the regions stay where they are.
+ */
+typedef struct region_shift {
+	int count;
+	const region_t* regions;
+	mem_addr_t offsets[MAX_REGIONS];
+} region_shift_t;
+
+mem_addr_t shiftRegions(void* shift, mem_addr_t addr);
+
+/* Whether any two regions overlap once moved, which no real placement
+ * would do */
+int shiftOverlaps(const region_shift_t* shift);
+
+/* Longest region name, with its terminating zero */
+#define REGION_NAME 16
+/* Default block size, in address bits, of automatic classification */
+#define REGION_BITS 32
+
+typedef struct region_table {
+	int count;
+	int bits;        // automatic: blocks of 2^bits bytes; 0 if ranges given
+	int last;        // region of the last address classified
+	region_t ranges[MAX_REGIONS];
+	char names[MAX_REGIONS][REGION_NAME];
+} region_table_t;
+
+/* An empty table classifying automatically by blocks of 2^bits bytes */
+void initRegionTable(region_table_t* table, int bits);
+
+/* Add an explicit "name=lo-hi" range, which turns automatic
+ * classification off; -1 if malformed, overlapping or out of room */
+int addNamedRegion(region_table_t* table, const char* spec);
+
+/* Whether the len bytes at name are a name automatic classification
+ * gives: stack, heap, globals or mmap */
+int isAutoRegion(const char* name, size_t len);
+
+/*
+ * The region of addr: its index in table, or -1 if it lies outside every
+ * range (or automatic classification ran out of room).  Automatic
+ * classification adds a region the first time its block is seen.
+ */
+int classifyAddress(region_table_t* table, mem_addr_t addr);
+
+#endif /* REGION_H */
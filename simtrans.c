@@ -0,0 +1,279 @@
+/*
+ * simtrans.c - Evaluate the transpose functions registered in trans.c
+ *     without Valgrind: each function runs once on real matrices while
+ *     its accesses to A and B are simulated in-process (see transsim.h).
+ *
+ * Every (function, matrix size, cache geometry) combination is evaluated
+ * on a pool of threads, and the functions are ranked by their misses.
+ *
+ * Usage: simtrans [-h] [-M <cols>] [-N <rows>] [-s <num>] [-E <num>] [-b <num>]
+ *                 [-z <MxN,...>] [-g <s:E:b,...>] [-j <threads>]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "cachelab.h"
+#include "transsim.h"
+
+/* The cache the handout grades against: 1KB, direct mapped, 32B blocks */
+#define DEFAULT_S 5
+#define DEFAULT_E 1
+#define DEFAULT_B 5
+
+/* Largest matrix side accepted */
+#define MAX_SIDE 4096
+
+/* Most matrix sizes and cache geometries in one sweep */
+#define MAX_SIZES 64
+#define MAX_GEOMETRIES 64
+
+typedef struct matrix_size { int M, N; } matrix_size_t;
+typedef struct geometry { int s, E, b; } geometry_t;
+
+/* One (function, size, geometry) combination and its result */
+typedef struct job {
+    int func;
+    int size;
+    int geometry;
+    trans_func_t result;
+} job_t;
+
+job_t* jobs;
+int job_count;
+int next_job = 0; /* claimed with an atomic increment by the workers */
+
+matrix_size_t sizes[MAX_SIZES];
+int size_count = 0;
+geometry_t geometries[MAX_GEOMETRIES];
+int geometry_count = 0;
+
+
+/*
+ * worker - thread pool body, evaluates combinations until none are left
+ * Every evaluation allocates its own cache and matrices, so the workers
+ * share nothing but the job counter.
+ */
+void* worker(void* arg)
+{
+    int i;
+    (void)arg;
+
+    while((i = __atomic_fetch_add(&next_job, 1, __ATOMIC_RELAXED)) < job_count) {
+        job_t* j = &jobs[i];
+        matrix_size_t* z = &sizes[j->size];
+        geometry_t* g = &geometries[j->geometry];
+
+        j->result = func_list[j->func];
+        evalTransFunction(&j->result, z->M, z->N, g->s, g->E, g->b);
+    }
+    return NULL;
+}
+
+
+/* Rank jobs by misses, incorrect functions last */
+int byMisses(const void* x, const void* y)
+{
+    const job_t* a = x;
+    const job_t* b = y;
+
+    if(a->result.correct != b->result.correct)
+        return b->result.correct - a->result.correct;
+    if(a->result.num_misses != b->result.num_misses)
+        return a->result.num_misses < b->result.num_misses ? -1 : 1;
+    return a->func - b->func;
+}
+
+
+/*
+ * parseSizes/parseGeometries - "32x32,61x67" and "5:1:5,6:2:5" lists
+ * Return -1 on a malformed or out of range entry.
+ */
+int parseSizes(char* list)
+{
+    for(char* tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+        matrix_size_t* z = &sizes[size_count];
+        if(size_count == MAX_SIZES || sscanf(tok, "%dx%d", &z->M, &z->N) != 2 ||
+           z->M < 1 || z->N < 1 || z->M > MAX_SIDE || z->N > MAX_SIDE)
+            return -1;
+        size_count++;
+    }
+    return 0;
+}
+
+int parseGeometries(char* list)
+{
+    for(char* tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+        geometry_t* g = &geometries[geometry_count];
+        if(geometry_count == MAX_GEOMETRIES ||
+           sscanf(tok, "%d:%d:%d", &g->s, &g->E, &g->b) != 3 ||
+           g->s < 0 || g->b < 0 || g->E < 1 || g->s > 24 || g->b > 12)
+            return -1;
+        geometry_count++;
+    }
+    return 0;
+}
+
+
+/*
+ * printUsage - Print usage info
+ */
+void printUsage(char* argv[])
+{
+    printf("Usage: %s [-h] [-M <cols>] [-N <rows>] [-s <num>] [-E <num>] [-b <num>]\n"
+           "          [-z <MxN,...>] [-g <s:E:b,...>] [-j <threads>]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h         Print this help message.\n");
+    printf("  -M <cols>  Number of matrix columns (default 32).\n");
+    printf("  -N <rows>  Number of matrix rows (default 32).\n");
+    printf("  -s <num>   Number of set index bits (default %d).\n", DEFAULT_S);
+    printf("  -E <num>   Number of lines per set (default %d).\n", DEFAULT_E);
+    printf("  -b <num>   Number of block offset bits (default %d).\n", DEFAULT_B);
+    printf("  -z <list>  Matrix sizes to sweep, e.g. 32x32,64x64,61x67.\n");
+    printf("  -g <list>  Cache geometries to sweep, e.g. 5:1:5,8:4:6.\n");
+    printf("  -j <num>   Number of threads (default: one per CPU).\n");
+    printf("\nExamples:\n");
+    printf("  linux>  %s -M 61 -N 67\n", argv[0]);
+    printf("  linux>  %s -z 32x32,64x64,61x67 -g 5:1:5,5:2:5,6:1:5\n", argv[0]);
+}
+
+int main(int argc, char* argv[])
+{
+    int M = 32, N = 32;
+    int s = DEFAULT_S, E = DEFAULT_E, b = DEFAULT_B;
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int c;
+
+    while((c = getopt(argc, argv, "M:N:s:E:b:z:g:j:h")) != -1) {
+        switch(c) {
+        case 'M':
+            M = atoi(optarg);
+            break;
+        case 'N':
+            N = atoi(optarg);
+            break;
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 'z':
+            if(parseSizes(optarg) != 0) {
+                printf("%s: bad matrix size in -z\n", argv[0]);
+                exit(1);
+            }
+            break;
+        case 'g':
+            if(parseGeometries(optarg) != 0) {
+                printf("%s: bad cache geometry in -g\n", argv[0]);
+                exit(1);
+            }
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 'h':
+            printUsage(argv);
+            exit(0);
+        default:
+            printUsage(argv);
+            exit(1);
+        }
+    }
+
+    //without lists, -M/-N and -s/-E/-b give the single combination
+    if(size_count == 0) {
+        sizes[0].M = M;
+        sizes[0].N = N;
+        size_count = 1;
+    }
+    if(geometry_count == 0) {
+        geometries[0].s = s;
+        geometries[0].E = E;
+        geometries[0].b = b;
+        geometry_count = 1;
+    }
+
+    for(int i = 0; i < size_count; i++) {
+        if(sizes[i].M < 1 || sizes[i].N < 1 || sizes[i].M > MAX_SIDE ||
+           sizes[i].N > MAX_SIDE) {
+            printf("%s: invalid matrix size\n", argv[0]);
+            exit(1);
+        }
+    }
+    for(int i = 0; i < geometry_count; i++) {
+        geometry_t* g = &geometries[i];
+        if(g->s < 0 || g->b < 0 || g->E < 1 || g->s > 24 || g->b > 12) {
+            printf("%s: invalid cache geometry\n", argv[0]);
+            exit(1);
+        }
+    }
+    if(threads < 1)
+        threads = 1;
+
+    registerFunctions();
+
+    //one job per combination, grouped by size and geometry
+    job_count = func_counter * size_count * geometry_count;
+    jobs = calloc(job_count, sizeof(job_t));
+    for(int i = 0; i < job_count; i++) {
+        jobs[i].func = i % func_counter;
+        jobs[i].geometry = i / func_counter % geometry_count;
+        jobs[i].size = i / func_counter / geometry_count;
+    }
+
+    pthread_t* tids = malloc(threads * sizeof(pthread_t));
+    for(int t = 0; t < threads; t++) {
+        if(pthread_create(&tids[t], NULL, worker, NULL) != 0) {
+            fprintf(stderr, "%s: can't start worker threads\n", argv[0]);
+            exit(1);
+        }
+    }
+    for(int t = 0; t < threads; t++)
+        pthread_join(tids[t], NULL);
+
+    printf("Simulated %d functions x %d sizes x %d geometries on %d threads\n",
+           func_counter, size_count, geometry_count, threads);
+
+    //one ranked table per size and geometry
+    for(int g = 0; g < size_count * geometry_count; g++) {
+        job_t* group = &jobs[g * func_counter];
+        matrix_size_t* z = &sizes[group->size];
+        geometry_t* geo = &geometries[group->geometry];
+
+        qsort(group, func_counter, sizeof(job_t), byMisses);
+        printf("\n%dx%d, s=%d E=%d b=%d\n", z->M, z->N, geo->s, geo->E, geo->b);
+        printf("%4s %4s %10s %10s %10s %7s  %s\n", "rank", "func", "misses",
+               "hits", "evictions", "correct", "description");
+        for(int k = 0; k < func_counter; k++) {
+            trans_func_t* r = &group[k].result;
+            printf("%4d %4d %10u %10u %10u %7d  %s\n", k + 1, group[k].func,
+                   r->num_misses, r->num_hits, r->num_evictions, r->correct,
+                   r->description);
+        }
+    }
+
+    //the handout grades the function described as "Transpose submission";
+    //its counts for the first combination go back into func_list
+    for(int k = 0; k < func_counter; k++) {
+        trans_func_t* r = &jobs[k].result;
+
+        func_list[jobs[k].func] = *r;
+        if(strcmp(r->description, "Transpose submission") == 0)
+            printf("\nSummary for official submission (func %d): "
+                   "correctness=%d misses=%u\n", jobs[k].func, r->correct,
+                   r->num_misses);
+    }
+
+    free(tids);
+    free(jobs);
+    return 0;
+}
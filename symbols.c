@@ -0,0 +1,270 @@
+/*
+ * symbols.c - Data symbols of a traced program, see symbols.h
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <elf.h>
+
+#include "symbols.h"
+
+/* Extent of a symbol with no size and no symbol after it */
+#define UNSIZED_EXTENT 4096
+
+
+/*
+ * readFile - a whole file in a malloc()ed, zero terminated buffer
+ */
+static char* readFile(const char* path, size_t* size)
+{
+	FILE* fp = fopen(path, "rb");
+	char* buf = NULL;
+	size_t len = 0, cap = 0, n;
+
+	if(!fp)
+		return NULL;
+
+	do {
+		if(len + 1 >= cap) {
+			char* more = realloc(buf, cap = cap ? 2 * cap : 65536);
+			if(!more) {
+				free(buf);
+				fclose(fp);
+				errno = ENOMEM;
+				return NULL;
+			}
+			buf = more;
+		}
+		n = fread(buf + len, 1, cap - len - 1, fp);
+		len += n;
+	} while(n > 0);
+
+	fclose(fp);
+	buf[len] = '\0';
+	*size = len;
+	return buf;
+}
+
+
+/*
+ * addSymbol - append a symbol, hi == lo if its size is unknown
+ */
+static int addSymbol(symbol_table_t* table, int* cap, mem_addr_t lo,
+                     mem_addr_t size, const char* name)
+{
+	if(table->count == *cap) {
+		symbol_t* more = realloc(table->syms, (*cap = *cap ? 2 * *cap : 256) *
+		                         sizeof(symbol_t));
+		if(!more) {
+			errno = ENOMEM;
+			return -1;
+		}
+		table->syms = more;
+	}
+
+	table->syms[table->count].lo = lo;
+	table->syms[table->count].hi = lo + size;
+	table->syms[table->count].name = name;
+	table->count++;
+	return 0;
+}
+
+
+/*
+ * readElf - the object symbols of a 64-bit little-endian ELF file, from
+ * .symtab or, if the file is stripped, .dynsym; names stay in buf
+ */
+static int readElf(symbol_table_t* table, char* buf, size_t size)
+{
+	Elf64_Ehdr eh;
+	int cap = 0;
+
+	if(size < sizeof(eh))
+		goto bad;
+	memcpy(&eh, buf, sizeof(eh));
+	if(eh.e_ident[EI_CLASS] != ELFCLASS64 || eh.e_ident[EI_DATA] != ELFDATA2LSB ||
+	   eh.e_shentsize != sizeof(Elf64_Shdr) || eh.e_shoff > size ||
+	   eh.e_shnum > (size - eh.e_shoff) / sizeof(Elf64_Shdr))
+		goto bad;
+
+	Elf64_Shdr* sh = (Elf64_Shdr*)(buf + eh.e_shoff);
+	int symtab = -1;
+
+	for(int i = 0; i < eh.e_shnum; i++) {
+		if(sh[i].sh_type == SHT_SYMTAB ||
+		   (sh[i].sh_type == SHT_DYNSYM && symtab < 0))
+			symtab = i;
+	}
+	if(symtab < 0)
+		return 0;
+
+	Elf64_Shdr* syms = &sh[symtab];
+	if(syms->sh_link >= eh.e_shnum || syms->sh_offset > size ||
+	   syms->sh_size > size - syms->sh_offset)
+		goto bad;
+	Elf64_Shdr* strs = &sh[syms->sh_link];
+	if(strs->sh_offset > size || strs->sh_size > size - strs->sh_offset)
+		goto bad;
+
+	const char* names = buf + strs->sh_offset;
+
+	for(size_t k = 0; k < syms->sh_size / sizeof(Elf64_Sym); k++) {
+		Elf64_Sym sym;
+
+		memcpy(&sym, buf + syms->sh_offset + k * sizeof(sym), sizeof(sym));
+		if(ELF64_ST_TYPE(sym.st_info) != STT_OBJECT ||
+		   sym.st_shndx == SHN_UNDEF || sym.st_name >= strs->sh_size ||
+		   !memchr(names + sym.st_name, '\0', strs->sh_size - sym.st_name))
+			continue;
+		if(addSymbol(table, &cap, sym.st_value, sym.st_size,
+		             names + sym.st_name) != 0)
+			return -1;
+	}
+	return 0;
+
+bad:
+	errno = EINVAL;
+	return -1;
+}
+
+
+/*
+ * readNm - the data symbols of nm output, "addr [size] type name" per
+ * line; lines are split in place, so names stay in buf
+ */
+static int readNm(symbol_table_t* table, char* buf)
+{
+	int cap = 0, lines = 0, parsed = 0;
+
+	for(char* line = buf; line && *line; lines++) {
+		char* next = strchr(line, '\n');
+		char* p = line;
+		char* end;
+
+		if(next)
+			*next++ = '\0';
+		line[strcspn(line, "\r")] = '\0';
+
+		mem_addr_t lo = strtoull(p, &end, 16), size = 0;
+		if(end == p || *end != ' ')
+			goto skip;
+		p = end + 1;
+
+		//nm -S puts the size between address and type
+		if(p[0] == '\0' || p[1] != ' ') {
+			size = strtoull(p, &end, 16);
+			if(end == p || *end != ' ')
+				goto skip;
+			p = end + 1;
+		}
+		if(p[0] == '\0' || p[1] != ' ' || p[2] == '\0')
+			goto skip;
+
+		parsed++;
+		if(strchr("BbDdGgRrSsVv", p[0]) &&
+		   addSymbol(table, &cap, lo, size, p + 2) != 0)
+			return -1;
+skip:
+		line = next;
+	}
+
+	//undefined symbols have no address, but nothing at all isn't nm
+	if(lines > 0 && parsed == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+
+static int byStart(const void* x, const void* y)
+{
+	const symbol_t* a = x;
+	const symbol_t* b = y;
+
+	//of two symbols at one address, keep the larger
+	if(a->lo != b->lo)
+		return a->lo < b->lo ? -1 : 1;
+	return a->hi > b->hi ? -1 : a->hi < b->hi;
+}
+
+
+int loadSymbols(symbol_table_t* table, const char* path, mem_addr_t base)
+{
+	size_t size;
+	int err;
+
+	memset(table, 0, sizeof(*table));
+	table->names = readFile(path, &size);
+	if(!table->names)
+		return -1;
+
+	if(size >= SELFMAG && memcmp(table->names, ELFMAG, SELFMAG) == 0)
+		err = readElf(table, table->names, size);
+	else
+		err = readNm(table, table->names);
+	if(err != 0) {
+		int saved = errno;
+		freeSymbols(table);
+		errno = saved;
+		return -1;
+	}
+
+	//sort, drop aliases and clip every symbol to the start of the next
+	qsort(table->syms, table->count, sizeof(symbol_t), byStart);
+
+	int kept = 0;
+	for(int i = 0; i < table->count; i++) {
+		if(kept && table->syms[i].lo == table->syms[kept-1].lo)
+			continue;
+		table->syms[kept++] = table->syms[i];
+	}
+	table->count = kept;
+
+	for(int i = 0; i < table->count; i++) {
+		symbol_t* sym = &table->syms[i];
+		mem_addr_t next = i + 1 < table->count ? table->syms[i+1].lo : 0;
+
+		if(sym->hi == sym->lo)
+			sym->hi = next ? next : sym->lo + UNSIZED_EXTENT;
+		else if(next && sym->hi > next)
+			sym->hi = next;
+		sym->lo += base;
+		sym->hi += base;
+	}
+	return 0;
+}
+
+
+void freeSymbols(symbol_table_t* table)
+{
+	free(table->syms);
+	free(table->names);
+	memset(table, 0, sizeof(*table));
+}
+
+
+int findSymbol(symbol_table_t* table, mem_addr_t addr)
+{
+	const symbol_t* syms = table->syms;
+	int lo = 0, hi = table->count - 1;
+
+	//consecutive accesses mostly stay within one variable
+	if(table->count && addr - syms[table->last].lo <
+	                   syms[table->last].hi - syms[table->last].lo)
+		return table->last;
+
+	while(lo <= hi) {
+		int mid = (lo + hi) / 2;
+
+		if(addr < syms[mid].lo)
+			hi = mid - 1;
+		else if(addr >= syms[mid].hi)
+			lo = mid + 1;
+		else
+			return table->last = mid;
+	}
+	return -1;
+}
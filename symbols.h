@@ -0,0 +1,48 @@
+/*
+ * symbols.h - Data symbols of a traced program
+ *
+ * A symbol table maps an address to the global or static variable that
+ * holds it, so misses can be charged to the array responsible for them.
+ * It is read either straight from the program's ELF file (its .symtab, or
+ * .dynsym if stripped) or from the output of nm, preferably nm -S so that
+ * symbols carry their sizes; without a size a symbol is taken to reach up
+ * to the next one.
+ *
+ * Only data symbols are kept (objects in ELF terms, nm types B, D, G, R, S
+ * and V).  The table is sorted and clipped so that no two symbols overlap,
+ * and an address is found by binary search, after checking the symbol
+ * found last: consecutive accesses mostly hit the same variable.
+ *
+ * A position independent program is loaded at some base address; give it
+ * to loadSymbols() so symbol addresses match the trace's.
+ */
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include "cachesim.h"
+
+typedef struct symbol {
+	mem_addr_t lo;
+	mem_addr_t hi;   // first address past the symbol
+	const char* name;
+} symbol_t;
+
+typedef struct symbol_table {
+	int count;
+	int last;         // symbol found by the last lookup
+	symbol_t* syms;   // sorted by address
+	char* names;      // storage for every name
+} symbol_table_t;
+
+/*
+ * Read the symbols of an ELF file or nm listing at path, moved up by base.
+ * Returns -1 with errno set on failure, EINVAL if the file is neither.
+ */
+int loadSymbols(symbol_table_t* table, const char* path, mem_addr_t base);
+
+void freeSymbols(symbol_table_t* table);
+
+/* Index of the symbol holding addr, or -1 */
+int findSymbol(symbol_table_t* table, mem_addr_t addr);
+
+#endif /* SYMBOLS_H */
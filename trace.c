@@ -0,0 +1,470 @@
+/*
+ * trace.c - Trace file readers and writers, see trace.h for the formats
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#include "trace.h"
+
+/* Bytes looked at to recognize a format */
+#define SNIFF_BYTES 4096
+/* Bytes of binary records decoded per read */
+#define BLOCK_BYTES 65536
+
+/* drcachesim trace_entry_t: type, size, addr, packed */
+#define DR_ENTRY_SIZE 12
+#define DR_TYPE_READ 0
+#define DR_TYPE_WRITE 1
+#define DR_TYPE_HEADER 25
+
+/* ChampSim input_instr: ip, branch info, registers, 2 stores, 4 loads */
+#define CHAMPSIM_RECORD_SIZE 64
+#define CHAMPSIM_DEST_MEM 16
+#define CHAMPSIM_SRC_MEM 32
+#define CHAMPSIM_MAX_ACCESSES 6
+
+static const char* format_names[] = {
+	"auto", "lackey", "pinatrace", "drmemtrace", "champsim"
+};
+
+
+const char* traceFormatName(trace_format_t format)
+{
+	return format_names[format];
+}
+
+int parseTraceFormat(const char* name)
+{
+	for(int i = 0; i < (int)(sizeof(format_names) / sizeof(format_names[0])); i++) {
+		if(strcmp(name, format_names[i]) == 0)
+			return i;
+	}
+	return -1;
+}
+
+
+/*
+ * isPinLine - does a text line look like "0x400a2b: R 0x601040"?
+ */
+static int isPinLine(const char* p)
+{
+	while(*p == ' ')
+		p++;
+	if(p[0] != '0' || p[1] != 'x')
+		return 0;
+	for(p += 2; isxdigit((unsigned char)*p); p++)
+		;
+	return p[0] == ':' && p[1] == ' ' && (p[2] == 'R' || p[2] == 'W');
+}
+
+
+/*
+ * sniffFormat - guess the format from the first bytes of a trace
+ * Binary formats are recognized by their first record (a drmemtrace file
+ * opens with a header entry), text is lackey unless it has pinatrace lines.
+ */
+static trace_format_t sniffFormat(FILE* fp)
+{
+	char buf[SNIFF_BYTES + 1];
+	size_t n = fread(buf, 1, SNIFF_BYTES, fp);
+	int text = 1;
+	uint16_t type;
+
+	rewind(fp);
+	if(n == 0)
+		return TRACE_LACKEY;
+
+	for(size_t i = 0; i < n; i++) {
+		unsigned char ch = buf[i];
+		if(!isprint(ch) && !isspace(ch)) {
+			text = 0;
+			break;
+		}
+	}
+
+	if(text) {
+		buf[n] = '\0';
+		for(char* line = buf; line && *line; line = strchr(line, '\n')) {
+			if(*line == '\n')
+				line++;
+			if(isPinLine(line))
+				return TRACE_PINATRACE;
+		}
+		return TRACE_LACKEY;
+	}
+
+	memcpy(&type, buf, sizeof(type));
+	if(n >= DR_ENTRY_SIZE && type == DR_TYPE_HEADER)
+		return TRACE_DRMEMTRACE;
+	if(n >= CHAMPSIM_RECORD_SIZE)
+		return TRACE_CHAMPSIM;
+	return TRACE_AUTO;
+}
+
+
+int openTrace(trace_reader_t* reader, const char* path, trace_format_t format,
+              int follow)
+{
+	memset(reader, 0, sizeof(*reader));
+	reader->fp = fopen(path, "rb");
+	if(!reader->fp)
+		return -1;
+
+	if(format == TRACE_AUTO)
+		format = sniffFormat(reader->fp);
+	if(format == TRACE_AUTO) {
+		fclose(reader->fp);
+		errno = EINVAL;
+		return -1;
+	}
+
+	reader->format = format;
+	reader->follow = follow;
+	return 0;
+}
+
+
+int seekTrace(trace_reader_t* reader, uint64_t offset)
+{
+	if(fseeko(reader->fp, offset, SEEK_SET) != 0)
+		return -1;
+	reader->offset = offset;
+	reader->eof = 0;
+	return 0;
+}
+
+
+void filterTrace(trace_reader_t* reader, int (*keep)(void*, mem_addr_t), void* arg)
+{
+	reader->keep = keep;
+	reader->keep_arg = arg;
+}
+
+
+/* kept - whether an access at addr passes the reader's filter */
+static inline int kept(const trace_reader_t* reader, mem_addr_t addr)
+{
+	return !reader->keep || reader->keep(reader->keep_arg, addr);
+}
+
+
+void closeTrace(trace_reader_t* reader)
+{
+	fclose(reader->fp);
+}
+
+
+/*
+ * readText - the text formats, a line at a time
+ */
+static int readText(trace_reader_t* reader, access_t* batch, int max)
+{
+	char buf[1000];
+	int n = 0;
+
+	while(n < max) {
+		if(fgets(buf, sizeof(buf), reader->fp) == NULL) {
+			reader->eof = 1;
+			break;
+		}
+
+		size_t len = strlen(buf);
+		if(len == 0)
+			continue;
+
+		//a line still being written, leave it for later
+		if(reader->follow && buf[len-1] != '\n' && feof(reader->fp)) {
+			reader->eof = 1;
+			break;
+		}
+
+		reader->offset += len;
+		reader->last_len = len;
+
+		access_t* a = &batch[n];
+		a->addr = 0;
+		a->len = 0;
+
+		if(reader->format == TRACE_LACKEY) {
+			//the op letter is at buf[1], instruction fetches are ignored
+			if(buf[1]=='S' || buf[1]=='L' || buf[1]=='M') {
+				a->op = buf[1];
+				sscanf(buf+3, "%llx,%u", &a->addr, &a->len);
+				if(kept(reader, a->addr))
+					n++;
+			}
+		} else {
+			mem_addr_t ip;
+			char op;
+
+			//the access size is only printed by some pinatrace versions
+			if(isPinLine(buf) &&
+			   sscanf(buf, "%llx: %c %llx %u", &ip, &op, &a->addr, &a->len) >= 3) {
+				a->op = op == 'W' ? 'S' : 'L';
+				if(a->len == 0)
+					a->len = 1;
+				if(kept(reader, a->addr))
+					n++;
+			}
+		}
+	}
+
+	return n;
+}
+
+
+/*
+ * readRecords - read up to count whole binary records of size bytes
+ * A trailing partial record is left unread, as it may still be written.
+ */
+static size_t readRecords(trace_reader_t* reader, unsigned char* block,
+                          size_t size, size_t count)
+{
+	size_t got = fread(block, 1, size * count, reader->fp);
+	size_t partial = got % size;
+
+	if(got < size * count)
+		reader->eof = 1;
+	if(partial)
+		fseeko(reader->fp, -(off_t)partial, SEEK_CUR);
+
+	reader->offset += got - partial;
+	if(got >= size)
+		reader->last_len = size;
+	return got / size;
+}
+
+
+/*
+ * readDrmemtrace - loads and stores of a drcachesim memtrace; instruction
+ * fetches, prefetches, markers and headers are skipped
+ */
+static int readDrmemtrace(trace_reader_t* reader, access_t* batch, int max)
+{
+	unsigned char block[BLOCK_BYTES];
+	int n = 0;
+
+	while(n == 0 && !reader->eof) {
+		size_t want = max < BLOCK_BYTES / DR_ENTRY_SIZE ? max
+		                                                : BLOCK_BYTES / DR_ENTRY_SIZE;
+		size_t got = readRecords(reader, block, DR_ENTRY_SIZE, want);
+
+		for(size_t i = 0; i < got; i++) {
+			unsigned char* e = block + i * DR_ENTRY_SIZE;
+			uint16_t type, size;
+			uint64_t addr;
+
+			memcpy(&type, e, sizeof(type));
+			if(type != DR_TYPE_READ && type != DR_TYPE_WRITE)
+				continue;
+			memcpy(&size, e + 2, sizeof(size));
+			memcpy(&addr, e + 4, sizeof(addr));
+			if(!kept(reader, addr))
+				continue;
+
+			batch[n].op = type == DR_TYPE_WRITE ? 'S' : 'L';
+			batch[n].addr = addr;
+			batch[n].len = size;
+			n++;
+		}
+	}
+
+	return n;
+}
+
+
+/*
+ * readChampsim - loads (source operands) then stores (destination
+ * operands) of every ChampSim instruction record; unused slots are zero
+ */
+static int readChampsim(trace_reader_t* reader, access_t* batch, int max)
+{
+	unsigned char block[BLOCK_BYTES];
+	int n = 0;
+
+	while(n == 0 && !reader->eof && max >= CHAMPSIM_MAX_ACCESSES) {
+		size_t want = max / CHAMPSIM_MAX_ACCESSES;
+		if(want > BLOCK_BYTES / CHAMPSIM_RECORD_SIZE)
+			want = BLOCK_BYTES / CHAMPSIM_RECORD_SIZE;
+		size_t got = readRecords(reader, block, CHAMPSIM_RECORD_SIZE, want);
+
+		for(size_t i = 0; i < got; i++) {
+			unsigned char* r = block + i * CHAMPSIM_RECORD_SIZE;
+			uint64_t addr;
+
+			for(int k = 0; k < 4; k++) {
+				memcpy(&addr, r + CHAMPSIM_SRC_MEM + 8 * k, sizeof(addr));
+				if(addr && kept(reader, addr)) {
+					batch[n].op = 'L';
+					batch[n].addr = addr;
+					batch[n].len = 1;
+					n++;
+				}
+			}
+			for(int k = 0; k < 2; k++) {
+				memcpy(&addr, r + CHAMPSIM_DEST_MEM + 8 * k, sizeof(addr));
+				if(addr && kept(reader, addr)) {
+					batch[n].op = 'S';
+					batch[n].addr = addr;
+					batch[n].len = 1;
+					n++;
+				}
+			}
+		}
+	}
+
+	return n;
+}
+
+
+int readTrace(trace_reader_t* reader, access_t* batch, int max)
+{
+	if(reader->eof)
+		return 0;
+
+	switch(reader->format) {
+	case TRACE_DRMEMTRACE:
+		return readDrmemtrace(reader, batch, max);
+	case TRACE_CHAMPSIM:
+		return readChampsim(reader, batch, max);
+	default:
+		return readText(reader, batch, max);
+	}
+}
+
+
+access_t* loadTrace(const char* path, trace_format_t format, size_t* count)
+{
+	trace_reader_t reader;
+	size_t n = 0, cap = TRACE_BATCH;
+	int got;
+
+	if(openTrace(&reader, path, format, 0) != 0)
+		return NULL;
+
+	access_t* recs = malloc(cap * sizeof(access_t));
+
+	//grow geometrically, always leaving room for a whole batch
+	while(recs && (got = readTrace(&reader, recs + n, TRACE_BATCH)) > 0) {
+		n += got;
+		if(n + TRACE_BATCH > cap) {
+			access_t* bigger = realloc(recs, 2 * cap * sizeof(access_t));
+			if(!bigger) {
+				free(recs);
+				recs = NULL;
+				errno = ENOMEM;
+				break;
+			}
+			recs = bigger;
+			cap *= 2;
+		}
+	}
+
+	closeTrace(&reader);
+	*count = n;
+	return recs;
+}
+
+
+int createTrace(trace_writer_t* writer, const char* path, trace_format_t format)
+{
+	if(format == TRACE_AUTO) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	writer->format = format;
+	writer->fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+	if(!writer->fp)
+		return -1;
+
+	//drcachesim traces open with a header entry, which is how they are sniffed
+	if(format == TRACE_DRMEMTRACE) {
+		unsigned char e[DR_ENTRY_SIZE] = { 0 };
+		uint16_t type = DR_TYPE_HEADER;
+
+		memcpy(e, &type, sizeof(type));
+		if(fwrite(e, DR_ENTRY_SIZE, 1, writer->fp) != 1)
+			return -1;
+	}
+	return 0;
+}
+
+
+/*
+ * writeDrEntry - one drcachesim load or store
+ */
+static void writeDrEntry(FILE* fp, uint16_t type, const access_t* a)
+{
+	unsigned char e[DR_ENTRY_SIZE];
+	uint16_t size = a->len;
+	uint64_t addr = a->addr;
+
+	memcpy(e, &type, sizeof(type));
+	memcpy(e + 2, &size, sizeof(size));
+	memcpy(e + 4, &addr, sizeof(addr));
+	fwrite(e, DR_ENTRY_SIZE, 1, fp);
+}
+
+
+int writeTrace(trace_writer_t* writer, const access_t* batch, int count)
+{
+	FILE* fp = writer->fp;
+
+	for(int i = 0; i < count; i++) {
+		const access_t* a = &batch[i];
+		int load = a->op != 'S';
+		int store = a->op != 'L';
+
+		switch(writer->format) {
+		case TRACE_LACKEY:
+			fprintf(fp, " %c %llx,%u\n", a->op, a->addr, a->len);
+			break;
+		case TRACE_PINATRACE:
+			if(load)
+				fprintf(fp, "0x0: R 0x%llx %u\n", a->addr, a->len);
+			if(store)
+				fprintf(fp, "0x0: W 0x%llx %u\n", a->addr, a->len);
+			break;
+		case TRACE_DRMEMTRACE:
+			if(load)
+				writeDrEntry(fp, DR_TYPE_READ, a);
+			if(store)
+				writeDrEntry(fp, DR_TYPE_WRITE, a);
+			break;
+		case TRACE_CHAMPSIM: {
+			//one instruction per access, a modify being a load and a store
+			unsigned char r[CHAMPSIM_RECORD_SIZE] = { 0 };
+			uint64_t addr = a->addr;
+
+			if(load)
+				memcpy(r + CHAMPSIM_SRC_MEM, &addr, sizeof(addr));
+			if(store)
+				memcpy(r + CHAMPSIM_DEST_MEM, &addr, sizeof(addr));
+			fwrite(r, CHAMPSIM_RECORD_SIZE, 1, fp);
+			break;
+		}
+		default:
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	return ferror(fp) ? -1 : 0;
+}
+
+
+int finishTrace(trace_writer_t* writer)
+{
+	int err = ferror(writer->fp);
+
+	if(writer->fp == stdout)
+		err |= fflush(stdout);
+	else
+		err |= fclose(writer->fp);
+	return err ? -1 : 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * trace.h - Trace file readers and writers
+ *
+ * Every supported trace format is decoded into batches of access_t, so the
+ * simulator itself never sees the on-disk representation:
+ *
+ *   lackey      Valgrind lackey text (" L 7ff000,8"), the default
+ *   pinatrace   Pin pinatrace text ("0x400a2b: W 0x601040")
+ *   drmemtrace  DynamoRIO drcachesim memtrace, 12 byte trace_entry_t records
+ *   champsim    ChampSim instruction traces, 64 byte input_instr records
+ *
+ * The binary formats are read a block of records at a time and decoded in
+ * place, without a detour through text.  A batch always ends on a record
+ * boundary, so offset can be used to resume reading later.
+ *
+ * A reader can be given a filter (keep) that drops accesses as they are
+ * decoded, before they ever reach a batch.
+ *
+ * Files including this header must enable POSIX declarations (for example
+ * by defining _POSIX_C_SOURCE 200809L) before any system header.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "cachesim.h"
+
+/* Default number of accesses handed out per batch */
+#define TRACE_BATCH 4096
+
+typedef enum trace_format {
+	TRACE_AUTO = 0,
+	TRACE_LACKEY,
+	TRACE_PINATRACE,
+	TRACE_DRMEMTRACE,
+	TRACE_CHAMPSIM
+} trace_format_t;
+
+typedef struct trace_reader {
+	FILE* fp;
+	trace_format_t format;
+	int follow;         // trace may still be growing, see openTrace()
+	int eof;
+	uint64_t offset;    // bytes consumed, always at a record boundary
+	uint32_t last_len;  // size of the last record consumed
+	int (*keep)(void* arg, mem_addr_t addr);  // optional filter, see above
+	void* keep_arg;
+} trace_reader_t;
+
+typedef struct trace_writer {
+	FILE* fp;
+	trace_format_t format;
+} trace_writer_t;
+
+/* Name of a format, and the format of a name (-1 if unknown) */
+const char* traceFormatName(trace_format_t format);
+int parseTraceFormat(const char* name);
+
+/*
+ * Open a trace, detecting its format if format is TRACE_AUTO.  With
+ * follow set, a final text line without its newline is taken to be still
+ * in the making and is not consumed.  Returns -1 with errno set on failure
+ * (EINVAL if the format can't be recognized).
+ */
+int openTrace(trace_reader_t* reader, const char* path, trace_format_t format,
+              int follow);
+
+/* Decode only the accesses for which keep(arg, addr) is non-zero */
+void filterTrace(trace_reader_t* reader, int (*keep)(void*, mem_addr_t), void* arg);
+
+/* Continue reading at a byte offset previously reported by the reader */
+int seekTrace(trace_reader_t* reader, uint64_t offset);
+
+/* Decode up to max accesses into batch; returns 0 at the end of the trace */
+int readTrace(trace_reader_t* reader, access_t* batch, int max);
+
+void closeTrace(trace_reader_t* reader);
+
+/* Decode a whole trace into memory; NULL (with errno set) on failure */
+access_t* loadTrace(const char* path, trace_format_t format, size_t* count);
+
+/*
+ * Create a trace in the given format (not TRACE_AUTO), or write it to
+ * stdout if path is "-".  Only lackey reads back to exactly the accesses
+ * written; the other formats have no modify operation, so an M is written
+ * as a load followed by a store to the same bytes (in one instruction for
+ * champsim), and
+ *   pinatrace   keeps the size
+ *   drmemtrace  keeps the size, truncated to its 16 bit field
+ *   champsim    drops the size, every access reads back as 1 byte, and an
+ *               access to address 0 reads back as no access at all
+ * Return -1 with errno set on failure.
+ */
+int createTrace(trace_writer_t* writer, const char* path, trace_format_t format);
+int writeTrace(trace_writer_t* writer, const access_t* batch, int count);
+int finishTrace(trace_writer_t* writer);
+
+#endif /* TRACE_H */
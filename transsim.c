@@ -0,0 +1,131 @@
+/*
+ * transsim.c - Simulating registered transpose functions in-process,
+ *     see transsim.h
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "transsim.h"
+
+/* Where the calling thread's instrumented accesses go */
+typedef struct sim_region {
+    cache_t* cache;
+    uintptr_t lo;
+    uintptr_t len;
+    int budget;
+    jmp_buf* abort;
+} sim_region_t;
+
+static __thread sim_region_t region;
+
+
+/*
+ * simulateRegion - start (or, with a NULL cache, stop) simulating the
+ * calling thread's accesses to [lo, lo + len)
+ */
+void simulateRegion(cache_t* cache, void* lo, size_t len)
+{
+    region.cache = cache;
+    region.lo = (uintptr_t)lo;
+    region.len = cache ? len : 0;
+    region.abort = NULL;
+}
+
+
+/*
+ * simulateBudget - abort the simulated function once it misses too often
+ */
+void simulateBudget(int budget, jmp_buf* abort)
+{
+    region.budget = budget;
+    region.abort = abort;
+}
+
+
+/*
+ * simulate - the body of every hook: accesses outside the region (the
+ * function's own locals, the driver, other threads' matrices) are ignored
+ * with a single unsigned compare
+ */
+static inline void simulate(void* addr)
+{
+    if((uintptr_t)addr - region.lo < region.len) {
+        accessData(region.cache, (mem_addr_t)(uintptr_t)addr);
+
+        if(region.abort && region.cache->miss_count > region.budget)
+            longjmp(*region.abort, 1);
+    }
+}
+
+
+/*
+ * Hooks called by code compiled with -fsanitize=thread.  Loads and stores
+ * count the same for the simulator; sizes are ignored, as in csim.
+ */
+#define HOOK(name) void name(void* addr) { simulate(addr); }
+
+void __tsan_init(void) {}
+void __tsan_func_entry(void* pc) { (void)pc; }
+void __tsan_func_exit(void) {}
+
+HOOK(__tsan_read1) HOOK(__tsan_read2) HOOK(__tsan_read4)
+HOOK(__tsan_read8) HOOK(__tsan_read16)
+HOOK(__tsan_write1) HOOK(__tsan_write2) HOOK(__tsan_write4)
+HOOK(__tsan_write8) HOOK(__tsan_write16)
+HOOK(__tsan_unaligned_read2) HOOK(__tsan_unaligned_read4)
+HOOK(__tsan_unaligned_read8) HOOK(__tsan_unaligned_read16)
+HOOK(__tsan_unaligned_write2) HOOK(__tsan_unaligned_write4)
+HOOK(__tsan_unaligned_write8) HOOK(__tsan_unaligned_write16)
+
+void __tsan_read_range(void* addr, size_t len) { (void)len; simulate(addr); }
+void __tsan_write_range(void* addr, size_t len) { (void)len; simulate(addr); }
+
+
+/*
+ * allocMatrices - room for A (N x M) and B (M x N), B starting TRANS_SPAN
+ * ints after A like the handout's static arrays, so that A and B alias in
+ * the cache the way they do in the traces.  Page aligned; free() the
+ * returned A to release both.
+ */
+int* allocMatrices(int M, int N, int** B)
+{
+    size_t span = (size_t)M * N > TRANS_SPAN ? (size_t)M * N : TRANS_SPAN;
+    int* A;
+
+    if(posix_memalign((void**)&A, 4096, 2 * span * sizeof(int)) != 0) {
+        fprintf(stderr, "allocMatrices: out of memory\n");
+        exit(1);
+    }
+    *B = A + span;
+    return A;
+}
+
+
+void evalTransFunction(trans_func_t* func, int M, int N, int s, int E, int b)
+{
+    cache_t cache;
+    int* B;
+    int* A = allocMatrices(M, N, &B);
+    int* ref = malloc((size_t)M * N * sizeof(int));
+
+    initMatrix(M, N, (void*)A, (void*)B);
+    initCache(&cache, s, E, b);
+
+    //only the matrices are simulated, from A to the end of B
+    simulateRegion(&cache, A, (char*)(B + (size_t)M * N) - (char*)A);
+    func->func_ptr(M, N, (void*)A, (void*)B);
+    simulateRegion(NULL, NULL, 0);
+
+    correctTrans(M, N, (void*)A, (void*)ref);
+    func->correct = memcmp(B, ref, (size_t)M * N * sizeof(int)) == 0;
+    func->num_hits = cache.hit_count;
+    func->num_misses = cache.miss_count;
+    func->num_evictions = cache.eviction_count;
+
+    freeCache(&cache);
+    free(ref);
+    free(A);
+}
@@ -0,0 +1,54 @@
+/*
+ * transsim.h - Simulating registered transpose functions in-process
+ *
+ * Instead of tracing a transpose function under Valgrind and replaying the
+ * trace with csim, the function is compiled with -fsanitize=thread, which
+ * makes the compiler call a __tsan_readN()/__tsan_writeN() hook before
+ * every load and store.  transsim.c implements those hooks (the sanitizer
+ * runtime itself is not linked in): while a function is being evaluated,
+ * every access that falls into its A or B matrix goes straight into a
+ * simulated cache.
+ *
+ * The hook state is per thread, so functions can be evaluated on several
+ * threads at once as long as each has its own cache and matrices.
+ */
+#ifndef TRANSSIM_H
+#define TRANSSIM_H
+
+#include <setjmp.h>
+
+#include "cachelab.h"
+#include "cachesim.h"
+
+/* Matrices are laid out like the handout's static A[256][256], B[256][256]:
+ * B starts TRANS_SPAN ints after A (or right after A for larger ones) */
+#define TRANS_SPAN (256 * 256)
+
+/* Register the (instrumented) functions of trans.c */
+void registerFunctions(void);
+
+/*
+ * Run func on freshly initialized M x N matrices (A is N rows of M ints),
+ * simulating its accesses to A and B on a cold cache of the given
+ * geometry.  Fills in func's hit, miss and eviction counts and sets
+ * func->correct by comparing B with correctTrans().
+ */
+void evalTransFunction(trans_func_t* func, int M, int N, int s, int E, int b);
+
+/*
+ * Lower-level interface: allocate matrices for an M x N transpose, and
+ * route the calling thread's accesses to [lo, lo + len) into cache until
+ * simulateRegion(NULL, 0, 0) is called.
+ */
+int* allocMatrices(int M, int N, int** B);
+void simulateRegion(cache_t* cache, void* lo, size_t len);
+
+/*
+ * Give up on the function being simulated as soon as the cache has seen
+ * more than budget misses, by longjmp()ing to abort (with value 1).  Used
+ * to cut evaluations short that can no longer beat the best one so far.
+ * Cleared by the next simulateRegion().
+ */
+void simulateBudget(int budget, jmp_buf* abort);
+
+#endif /* TRANSSIM_H */
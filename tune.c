@@ -0,0 +1,51 @@
+/*
+ * tune.c - Parameterised transpose kernels searched by autotune
+ *
+ * Compiled with the same instrumentation as trans.c, so every access to A
+ * and B can be simulated in-process (see transsim.h).
+ */
+#include "tune.h"
+
+/*
+ * tiledTrans - transpose A tile by tile, bh rows by bw columns at a time.
+ * In a direct mapped cache, A[i][i] and B[i][i] usually map to the same
+ * set, so tiles on the diagonal can either defer the diagonal element to
+ * the end of its row, or read the whole tile row before writing it (the
+ * locals are not simulated, they stand for registers).
+ */
+void tiledTrans(int M, int N, int A[N][M], int B[M][N], const tile_params_t* p)
+{
+    int i, j, ii, jj, tmp = 0;
+    int bw = p->bw, bh = p->bh, diag = p->diag;
+    int row[MAX_TILE];
+
+    for (ii = 0; ii < N; ii += bh) {
+        for (jj = 0; jj < M; jj += bw) {
+            for (i = ii; i < ii + bh && i < N; i++) {
+                if (diag == DIAG_ROW) {
+                    for (j = jj; j < jj + bw && j < M; j++)
+                        row[j - jj] = A[i][j];
+                    for (j = jj; j < jj + bw && j < M; j++)
+                        B[j][i] = row[j - jj];
+                } else if (diag == DIAG_DEFER) {
+                    int deferred = -1;
+                    for (j = jj; j < jj + bw && j < M; j++) {
+                        if (i == j) {
+                            deferred = j;
+                            tmp = A[i][j];
+                        } else {
+                            B[j][i] = A[i][j];
+                        }
+                    }
+                    if (deferred >= 0)
+                        B[deferred][i] = tmp;
+                } else {
+                    for (j = jj; j < jj + bw && j < M; j++) {
+                        tmp = A[i][j];
+                        B[j][i] = tmp;
+                    }
+                }
+            }
+        }
+    }
+}
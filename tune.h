@@ -0,0 +1,27 @@
+/*
+ * tune.h - Parameterised transpose kernels searched by autotune
+ */
+#ifndef TUNE_H
+#define TUNE_H
+
+/* Largest tile side the kernels (and the search) support */
+#define MAX_TILE 64
+
+/* How tiles on the diagonal are handled */
+enum {
+    DIAG_NONE = 0,  /* copy element by element like any other tile */
+    DIAG_DEFER,     /* write the diagonal element after the rest of its row */
+    DIAG_ROW,       /* read a tile row into locals before writing any of it */
+    DIAG_MODES
+};
+
+typedef struct tile_params {
+    int bw;     /* tile width, in columns of A */
+    int bh;     /* tile height, in rows of A */
+    int diag;   /* one of the DIAG_ modes */
+} tile_params_t;
+
+/* Blocked transpose B = A^T with the given tiling */
+void tiledTrans(int M, int N, int A[N][M], int B[M][N], const tile_params_t* p);
+
+#endif /* TUNE_H */